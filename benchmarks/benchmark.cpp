@@ -0,0 +1,441 @@
+/*
+ * The MIT No Attribution License (MIT-0)
+ *
+ * Copyright (c) 2017-2020 Morwenn
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../poplar.h"
+
+////////////////////////////////////////////////////////////
+// Element types
+////////////////////////////////////////////////////////////
+
+struct record
+{
+    std::uint64_t key;
+    char payload[56];
+
+    friend auto operator<(const record& lhs, const record& rhs)
+        -> bool
+    {
+        return lhs.key < rhs.key;
+    }
+};
+
+template<typename T>
+auto make_value(int n)
+    -> T
+{
+    return static_cast<T>(n);
+}
+
+template<>
+auto make_value<std::string>(int n)
+    -> std::string
+{
+    // Long enough to defeat the small string optimization
+    char buffer[32];
+    std::snprintf(buffer, sizeof buffer, "poplar-heap-key-%012d", n);
+    return buffer;
+}
+
+template<>
+auto make_value<record>(int n)
+    -> record
+{
+    record res;
+    res.key = static_cast<std::uint64_t>(n);
+    std::memset(res.payload, n & 0xff, sizeof res.payload);
+    return res;
+}
+
+////////////////////////////////////////////////////////////
+// Distributions
+////////////////////////////////////////////////////////////
+
+struct distribution
+{
+    const char* name;
+    std::vector<int> (*generate)(std::size_t size, std::mt19937& engine);
+};
+
+const distribution distributions[] = {
+    { "random", [](std::size_t size, std::mt19937& engine) {
+        std::vector<int> res(size);
+        std::uniform_int_distribution<int> dist(0, static_cast<int>(size));
+        for (auto& value: res) value = dist(engine);
+        return res;
+    }},
+    { "sorted", [](std::size_t size, std::mt19937&) {
+        std::vector<int> res(size);
+        for (std::size_t i = 0 ; i < size ; ++i) res[i] = static_cast<int>(i);
+        return res;
+    }},
+    { "reversed", [](std::size_t size, std::mt19937&) {
+        std::vector<int> res(size);
+        for (std::size_t i = 0 ; i < size ; ++i) res[i] = static_cast<int>(size - i);
+        return res;
+    }},
+    { "few-unique", [](std::size_t size, std::mt19937& engine) {
+        std::vector<int> res(size);
+        std::uniform_int_distribution<int> dist(0, 15);
+        for (auto& value: res) value = dist(engine);
+        return res;
+    }},
+    { "organ-pipe", [](std::size_t size, std::mt19937&) {
+        std::vector<int> res(size);
+        for (std::size_t i = 0 ; i < size ; ++i) {
+            res[i] = static_cast<int>(i < size / 2 ? i : size - i);
+        }
+        return res;
+    }},
+};
+
+////////////////////////////////////////////////////////////
+// Benchmarked operations
+////////////////////////////////////////////////////////////
+
+// Every operation gets a copy of the input, prepares it outside of
+// the timed region, then runs the timed part with the comparator
+
+struct std_algorithms
+{
+    static constexpr const char* name = "std";
+
+    template<typename Vector, typename Compare>
+    static auto make_heap(Vector& vec, Compare compare) -> void
+    {
+        std::make_heap(vec.begin(), vec.end(), compare);
+    }
+
+    template<typename Vector, typename Compare>
+    static auto push_heap(Vector& vec, Compare compare) -> void
+    {
+        for (auto it = vec.begin() ; it != vec.end() ; ++it) {
+            std::push_heap(vec.begin(), std::next(it), compare);
+        }
+    }
+
+    template<typename Vector, typename Compare>
+    static auto pop_heap(Vector& vec, Compare compare) -> void
+    {
+        for (auto it = vec.end() ; it != vec.begin() ; --it) {
+            std::pop_heap(vec.begin(), it, compare);
+        }
+    }
+
+    template<typename Vector, typename Compare>
+    static auto sort_heap(Vector& vec, Compare compare) -> void
+    {
+        std::sort_heap(vec.begin(), vec.end(), compare);
+    }
+
+    template<typename Vector, typename Compare>
+    static auto is_heap_until(Vector& vec, Compare compare) -> void
+    {
+        if (std::is_heap_until(vec.begin(), vec.end(), compare) != vec.end()) {
+            std::abort();
+        }
+    }
+
+    template<typename Vector, typename Compare>
+    static auto priority_queue(Vector& vec, Compare compare) -> void
+    {
+        using value_type = typename Vector::value_type;
+        std::priority_queue<value_type, std::vector<value_type>, Compare> queue(compare);
+        for (auto& value: vec) queue.push(std::move(value));
+        for (auto it = vec.begin() ; it != vec.end() ; ++it) {
+            *it = queue.top();
+            queue.pop();
+        }
+    }
+
+    template<typename Vector, typename Compare>
+    static auto prepare_heap(Vector& vec, Compare compare) -> void
+    {
+        std::make_heap(vec.begin(), vec.end(), compare);
+    }
+};
+
+template<typename SiftPolicy>
+struct poplar_algorithms
+{
+    static constexpr SiftPolicy policy = {};
+
+    template<typename Vector, typename Compare>
+    static auto make_heap(Vector& vec, Compare compare) -> void
+    {
+        poplar::make_heap(vec.begin(), vec.end(), compare, policy);
+    }
+
+    template<typename Vector, typename Compare>
+    static auto push_heap(Vector& vec, Compare compare) -> void
+    {
+        for (auto it = vec.begin() ; it != vec.end() ; ++it) {
+            poplar::push_heap(vec.begin(), std::next(it), compare, policy);
+        }
+    }
+
+    template<typename Vector, typename Compare>
+    static auto pop_heap(Vector& vec, Compare compare) -> void
+    {
+        for (auto it = vec.end() ; it != vec.begin() ; --it) {
+            poplar::pop_heap(vec.begin(), it, compare, policy);
+        }
+    }
+
+    template<typename Vector, typename Compare>
+    static auto sort_heap(Vector& vec, Compare compare) -> void
+    {
+        poplar::sort_heap(vec.begin(), vec.end(), compare, policy);
+    }
+
+    template<typename Vector, typename Compare>
+    static auto is_heap_until(Vector& vec, Compare compare) -> void
+    {
+        if (poplar::is_heap_until(vec.begin(), vec.end(), compare) != vec.end()) {
+            std::abort();
+        }
+    }
+
+    template<typename Vector, typename Compare>
+    static auto priority_queue(Vector& vec, Compare compare) -> void
+    {
+        using value_type = typename Vector::value_type;
+        poplar::priority_queue<value_type, std::vector<value_type>, Compare> queue(compare);
+        for (auto& value: vec) queue.push(std::move(value));
+        for (auto it = vec.begin() ; it != vec.end() ; ++it) {
+            *it = queue.top();
+            queue.pop();
+        }
+    }
+
+    template<typename Vector, typename Compare>
+    static auto prepare_heap(Vector& vec, Compare compare) -> void
+    {
+        poplar::make_heap(vec.begin(), vec.end(), compare);
+    }
+};
+
+template<typename SiftPolicy>
+constexpr SiftPolicy poplar_algorithms<SiftPolicy>::policy;
+
+struct poplar_default: poplar_algorithms<poplar::default_sift_t>
+{
+    static constexpr const char* name = "poplar";
+};
+
+struct poplar_bottom_up: poplar_algorithms<poplar::bottom_up_sift_t>
+{
+    static constexpr const char* name = "poplar-bottom-up";
+};
+
+struct poplar_prefetch: poplar_algorithms<poplar::prefetch_sift_t>
+{
+    static constexpr const char* name = "poplar-prefetch";
+};
+
+// Only benchmarked for make_heap
+struct poplar_top_down: poplar_default
+{
+    static constexpr const char* name = "poplar-top-down";
+
+    template<typename Vector, typename Compare>
+    static auto make_heap(Vector& vec, Compare compare) -> void
+    {
+        poplar::make_heap(vec.begin(), vec.end(), compare, poplar::default_sift, poplar::top_down_build);
+    }
+};
+
+////////////////////////////////////////////////////////////
+// Benchmark driver
+////////////////////////////////////////////////////////////
+
+enum struct operation
+{
+    make_heap,
+    push_heap,
+    pop_heap,
+    sort_heap,
+    is_heap_until,
+    priority_queue
+};
+
+const char* const operation_names[] = {
+    "make_heap",
+    "push_heap",
+    "pop_heap",
+    "sort_heap",
+    "is_heap_until",
+    "priority_queue"
+};
+
+template<typename Algorithms, typename Vector, typename Compare>
+auto run(operation op, Vector& vec, Compare compare)
+    -> void
+{
+    switch (op) {
+        case operation::make_heap:      Algorithms::make_heap(vec, compare);      break;
+        case operation::push_heap:      Algorithms::push_heap(vec, compare);      break;
+        case operation::pop_heap:       Algorithms::pop_heap(vec, compare);       break;
+        case operation::sort_heap:      Algorithms::sort_heap(vec, compare);      break;
+        case operation::is_heap_until:  Algorithms::is_heap_until(vec, compare);  break;
+        case operation::priority_queue: Algorithms::priority_queue(vec, compare); break;
+    }
+}
+
+auto needs_heap(operation op)
+    -> bool
+{
+    return op == operation::pop_heap
+        || op == operation::sort_heap
+        || op == operation::is_heap_until;
+}
+
+// Runs the operation enough times to get a stable measurement and
+// returns the best time per element in nanoseconds
+template<typename Algorithms, typename T>
+auto measure(operation op, const std::vector<T>& input)
+    -> double
+{
+    using clock = std::chrono::steady_clock;
+    constexpr auto min_total_time = std::chrono::milliseconds(200);
+    constexpr int min_runs = 3;
+
+    double best = 0.0;
+    auto total = clock::duration::zero();
+    for (int runs = 0 ; runs < min_runs || total < min_total_time ; ++runs) {
+        auto vec = input;
+        if (needs_heap(op)) {
+            Algorithms::prepare_heap(vec, std::less<>{});
+        }
+
+        auto start = clock::now();
+        run<Algorithms>(op, vec, std::less<>{});
+        auto elapsed = clock::now() - start;
+
+        total += elapsed;
+        double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+        if (runs == 0 || ns < best) {
+            best = ns;
+        }
+    }
+    return best / static_cast<double>(input.size());
+}
+
+// Runs the operation once with a counting comparator; when compiled
+// with POPLAR_STATS, the poplar algorithms also record their swaps,
+// moves and sifts
+template<typename Algorithms, typename T>
+auto collect_stats(operation op, const std::vector<T>& input)
+    -> poplar::stats
+{
+    auto vec = input;
+    if (needs_heap(op)) {
+        Algorithms::prepare_heap(vec, std::less<>{});
+    }
+    poplar::thread_stats() = poplar::stats{};
+    run<Algorithms>(op, vec, poplar::counting_compare<std::less<>>{});
+    return poplar::thread_stats();
+}
+
+template<typename Algorithms, typename T>
+auto report(operation op, const char* type_name, const char* distribution_name,
+            const std::vector<T>& input)
+    -> void
+{
+    double ns = measure<Algorithms>(op, input);
+    auto stats = collect_stats<Algorithms>(op, input);
+    auto per_element = [&](std::uint64_t n) {
+        return static_cast<double>(n) / static_cast<double>(input.size());
+    };
+
+    std::printf("%s,%s,%s,%zu,%s,%.3f,%.3f",
+                operation_names[static_cast<int>(op)], type_name, distribution_name,
+                input.size(), Algorithms::name, ns, per_element(stats.comparisons));
+#ifdef POPLAR_STATS
+    std::printf(",%.3f,%.3f,%.3f,%llu",
+                per_element(stats.swaps), per_element(stats.moves),
+                stats.sifts ? double(stats.sift_levels) / double(stats.sifts) : 0.0,
+                static_cast<unsigned long long>(stats.max_sift_depth));
+#endif
+    std::printf("\n");
+    std::fflush(stdout);
+}
+
+template<typename T>
+auto benchmark_type(const char* type_name, std::size_t max_size, const char* filter)
+    -> void
+{
+    for (int op_index = 0 ; op_index < 6 ; ++op_index) {
+        auto op = static_cast<operation>(op_index);
+        if (filter && !std::strstr(operation_names[op_index], filter)) continue;
+
+        for (const auto& dist: distributions) {
+            for (std::size_t size = 100 ; size <= max_size ; size *= 10) {
+                std::mt19937 engine(123456789u);
+                auto keys = dist.generate(size, engine);
+                std::vector<T> input;
+                input.reserve(size);
+                for (int key: keys) input.push_back(make_value<T>(key));
+
+                report<std_algorithms>(op, type_name, dist.name, input);
+                report<poplar_default>(op, type_name, dist.name, input);
+                report<poplar_bottom_up>(op, type_name, dist.name, input);
+                report<poplar_prefetch>(op, type_name, dist.name, input);
+                if (op == operation::make_heap) {
+                    report<poplar_top_down>(op, type_name, dist.name, input);
+                }
+            }
+        }
+    }
+}
+
+// Usage: benchmark [max-size] [operation-filter] [type-filter]
+int main(int argc, char* argv[])
+{
+    std::size_t max_size = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    const char* op_filter = argc > 2 ? argv[2] : nullptr;
+    const char* type_filter = argc > 3 ? argv[3] : nullptr;
+
+    auto selected = [&](const char* type_name) {
+        return type_filter == nullptr || std::strcmp(type_filter, type_name) == 0;
+    };
+
+    std::printf("operation,type,distribution,size,library,ns_per_element,comparisons_per_element");
+#ifdef POPLAR_STATS
+    std::printf(",swaps_per_element,moves_per_element,mean_sift_depth,max_sift_depth");
+#endif
+    std::printf("\n");
+    if (selected("int"))    benchmark_type<int>("int", max_size, op_filter);
+    if (selected("double")) benchmark_type<double>("double", max_size, op_filter);
+    if (selected("string")) benchmark_type<std::string>("string", max_size, op_filter);
+    if (selected("record")) benchmark_type<record>("record", max_size, op_filter);
+}
@@ -24,15 +24,231 @@
 ////////////////////////////////////////////////////////////
 // Headers
 ////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <array>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <iterator>
 #include <limits>
+#include <memory>
 #include <type_traits>
 #include <utility>
+#include <vector>
+#if __cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+#   include <bit>
+#endif
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+
+////////////////////////////////////////////////////////////
+// Configuration
+////////////////////////////////////////////////////////////
+
+// The algorithms are constexpr when the standard library functions
+// they rely on are constexpr too, which is the case since C++20
+#if __cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+#   define POPLAR_CONSTEXPR constexpr
+#else
+#   define POPLAR_CONSTEXPR
+#endif
 
 namespace poplar
 {
+    ////////////////////////////////////////////////////////////
+    // Sift policies
+    ////////////////////////////////////////////////////////////
+
+    // Sifts an element down its poplar by exchanging it with the
+    // bigger of its children roots until it finds its place, which
+    // costs two comparisons and one swap per level
+    struct swap_sift_t {};
+    constexpr swap_sift_t swap_sift{};
+
+    // Same as swap_sift, except that the sifted element is moved to
+    // a temporary and the children roots are moved up into the hole
+    // it leaves, which costs one move per level instead of a swap
+    struct hole_sift_t {};
+    constexpr hole_sift_t hole_sift{};
+
+    // Picks hole_sift when use_hole_sift is true for the value type
+    // of the sifted sequence, and swap_sift otherwise
+    struct default_sift_t {};
+    constexpr default_sift_t default_sift{};
+
+    // Goes down to a leaf by following the bigger children roots,
+    // which only costs one comparison per level, then climbs back
+    // to find the place of the sifted element; this is generally
+    // cheaper when comparisons are expensive since the sifted
+    // element tends to end up close to the leaves
+    struct bottom_up_sift_t {};
+    constexpr bottom_up_sift_t bottom_up_sift{};
+
+    // Same as hole_sift, except that the children roots of the next
+    // level are prefetched while the current one is compared, and that
+    // pop_heap prefetches the poplar roots while looking for the bigger
+    // one; only worth it for heaps that don't fit in the cache
+    struct prefetch_sift_t {};
+    constexpr prefetch_sift_t prefetch_sift{};
+
+    ////////////////////////////////////////////////////////////
+    // make_heap strategies
+    ////////////////////////////////////////////////////////////
+
+    // Builds small poplars from left to right and fuses them as soon
+    // as possible following a binary carry sequence, which only needs
+    // O(1) extra space; this is the default strategy
+    struct binary_carry_build_t {};
+    constexpr binary_carry_build_t binary_carry_build{};
+
+    // Builds the final poplars one after the other, each of them by
+    // recursively building its subpoplars then sifting its root; it
+    // needs O(log n) extra space for the recursion, but works on one
+    // subpoplar at a time, which is friendlier to the cache when the
+    // heap is big
+    struct top_down_build_t {};
+    constexpr top_down_build_t top_down_build{};
+
+    // Tells whether default_sift should move elements of type T through
+    // a hole instead of swapping them; swapping small trivially copyable
+    // values is cheap, but moving heavier values is generally cheaper
+    // than swapping them. Can be specialized for user-defined types
+    template<typename T>
+    struct use_hole_sift:
+        std::integral_constant<
+            bool,
+            !std::is_trivially_copyable<T>::value || (sizeof(T) > 2 * sizeof(void*))
+        >
+    {};
+
+    // Size of the poplars that make_heap builds directly by sorting
+    // elements before fusing them into bigger poplars; has to be of the
+    // form 2^n-1, and can be specialized to tune make_heap for specific
+    // value types
+    template<typename T>
+    struct small_poplar_size:
+        std::integral_constant<std::size_t, 15>
+    {};
+
+    ////////////////////////////////////////////////////////////
+    // Instrumentation
+    ////////////////////////////////////////////////////////////
+
+    // Statistics accumulated by the algorithms of the current thread
+    // when POPLAR_STATS is defined before including this header; they
+    // can be reset by assigning stats{} to thread_stats(). Comparisons
+    // are only counted by comparators wrapped in counting_compare
+    struct stats
+    {
+        std::uint64_t comparisons = 0;
+        std::uint64_t swaps = 0;
+        std::uint64_t moves = 0;
+        std::uint64_t sifts = 0;
+        // Total number of levels the sifted elements went down
+        std::uint64_t sift_levels = 0;
+        std::uint64_t max_sift_depth = 0;
+    };
+
+    inline auto thread_stats() noexcept
+        -> stats&
+    {
+        thread_local stats res;
+        return res;
+    }
+
+    // Wraps a comparator and counts the number of times it is called;
+    // the counter is not synchronized, so the parallel algorithms have
+    // to be given one counting_compare per thread
+    template<typename Compare>
+    struct counting_compare
+    {
+        Compare compare;
+        std::uint64_t* count;
+
+        explicit counting_compare(Compare comp={}) noexcept:
+            counting_compare(std::move(comp), thread_stats().comparisons)
+        {}
+
+        counting_compare(Compare comp, std::uint64_t& counter) noexcept:
+            compare(std::move(comp)),
+            count(&counter)
+        {}
+
+        template<typename T, typename U>
+        auto operator()(T&& lhs, U&& rhs)
+            -> bool
+        {
+            ++*count;
+            return compare(std::forward<T>(lhs), std::forward<U>(rhs));
+        }
+    };
+
+    namespace detail
+    {
+        // Hooks called by the algorithms to record their statistics,
+        // they do nothing when POPLAR_STATS is not defined
+
+#ifdef POPLAR_STATS
+        inline auto record_swaps(std::uint64_t n) noexcept
+            -> void
+        {
+            thread_stats().swaps += n;
+        }
+
+        inline auto record_moves(std::uint64_t n) noexcept
+            -> void
+        {
+            thread_stats().moves += n;
+        }
+
+        // Records one sift, level() is called every time the sifted
+        // element goes down one level
+        struct sift_recorder
+        {
+            std::uint64_t depth = 0;
+
+            sift_recorder() noexcept
+            {
+                ++thread_stats().sifts;
+            }
+
+            sift_recorder(const sift_recorder&) = delete;
+            sift_recorder& operator=(const sift_recorder&) = delete;
+
+            ~sift_recorder()
+            {
+                auto& res = thread_stats();
+                res.sift_levels += depth;
+                if (depth > res.max_sift_depth) {
+                    res.max_sift_depth = depth;
+                }
+            }
+
+            auto level() noexcept
+                -> void
+            {
+                ++depth;
+            }
+        };
+#else
+        constexpr auto record_swaps(std::uint64_t) noexcept
+            -> void
+        {}
+
+        constexpr auto record_moves(std::uint64_t) noexcept
+            -> void
+        {}
+
+        struct sift_recorder
+        {
+            constexpr auto level() const noexcept
+                -> void
+            {}
+        };
+#endif
+    }
+
     namespace detail
     {
         ////////////////////////////////////////////////////////////
@@ -52,13 +268,20 @@ namespace poplar
             return n & ~(n >> 1);
         }
 
-        // Returns 2^floor(log2(n)), assumes n > 0
+        // Returns 2^floor(log2(n)), assumes n > 0; it is called once per
+        // poplar by the root scans, so every compiler gets a fast path:
+        // std::bit_floor when available, and intrinsics for the standard
+        // unsigned types otherwise
 
         template<typename Unsigned>
         constexpr auto unguarded_bit_floor(Unsigned n) noexcept
             -> Unsigned
         {
+#if defined(__cpp_lib_int_pow2)
+            return std::bit_floor(n);
+#else
             return bit_floor(n);
+#endif
         }
 
 #if defined(__GNUC__) || defined(__clang__)
@@ -82,7 +305,73 @@ namespace poplar
             constexpr auto k = std::numeric_limits<unsigned long long>::digits;
             return 1ull << (k - 1 - __builtin_clzll(n));
         }
+
+#   if defined(__SIZEOF_INT128__)
+        __extension__ using uint128_t = unsigned __int128;
+
+        constexpr auto unguarded_bit_floor(uint128_t n) noexcept
+            -> uint128_t
+        {
+            auto high = static_cast<unsigned long long>(n >> 64);
+            if (high != 0) {
+                return uint128_t(unguarded_bit_floor(high)) << 64;
+            }
+            return unguarded_bit_floor(static_cast<unsigned long long>(n));
+        }
+#   endif
+#elif defined(_MSC_VER) && !defined(__cpp_lib_int_pow2)
+        inline auto unguarded_bit_floor(unsigned long n) noexcept
+            -> unsigned long
+        {
+            unsigned long index;
+            _BitScanReverse(&index, n);
+            return 1ul << index;
+        }
+
+        inline auto unguarded_bit_floor(unsigned int n) noexcept
+            -> unsigned int
+        {
+            return unguarded_bit_floor(static_cast<unsigned long>(n));
+        }
+
+#   if defined(_M_X64) || defined(_M_ARM64)
+        inline auto unguarded_bit_floor(unsigned long long n) noexcept
+            -> unsigned long long
+        {
+            unsigned long index;
+            _BitScanReverse64(&index, n);
+            return 1ull << index;
+        }
+#   endif
+#endif
+
+        // Hints the processor that the element pointed to by the iterator
+        // will be read soon; only iterators whose reference type is a
+        // real reference can give the address of an element
+
+        template<typename Iterator>
+        auto prefetch(Iterator it, std::true_type)
+            -> void
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            __builtin_prefetch(std::addressof(*it));
+#else
+            (void) it;
 #endif
+        }
+
+        template<typename Iterator>
+        auto prefetch(Iterator, std::false_type)
+            -> void
+        {}
+
+        template<typename Iterator>
+        auto prefetch(Iterator it)
+            -> void
+        {
+            using reference = typename std::iterator_traits<Iterator>::reference;
+            prefetch(std::move(it), std::is_reference<reference>{});
+        }
 
         ////////////////////////////////////////////////////////////
         // Insertion sorts
@@ -90,8 +379,9 @@ namespace poplar
 
         // Insertion sort which doesn't check for empty sequences
         template<typename BidirectionalIterator, typename Compare>
-        auto unchecked_insertion_sort(BidirectionalIterator first, BidirectionalIterator last,
-                            Compare compare)
+        POPLAR_CONSTEXPR auto unchecked_insertion_sort(BidirectionalIterator first,
+                                                       BidirectionalIterator last,
+                                                       Compare compare)
             -> void
         {
             for (auto cur = std::next(first) ; cur != last ; ++cur) {
@@ -104,29 +394,158 @@ namespace poplar
                     auto tmp = std::move(*sift);
                     do {
                         *sift = std::move(*sift_1);
+                        record_moves(1);
                     } while (--sift != first && compare(tmp, *--sift_1));
                     *sift = std::move(tmp);
+                    record_moves(2);
                 }
             }
         }
 
         template<typename BidirectionalIterator, typename Compare>
-        auto insertion_sort(BidirectionalIterator first, BidirectionalIterator last,
-                            Compare compare)
+        POPLAR_CONSTEXPR auto insertion_sort(BidirectionalIterator first, BidirectionalIterator last,
+                                             Compare compare)
             -> void
         {
             if (first == last) return;
             unchecked_insertion_sort(std::move(first), std::move(last), std::move(compare));
         }
 
+        ////////////////////////////////////////////////////////////
+        // Sorting networks
+
+        // Branchless compare-exchange, only meant for cheap to copy types
+        template<typename RandomAccessIterator, typename Compare>
+        POPLAR_CONSTEXPR auto compare_exchange(RandomAccessIterator lhs, RandomAccessIterator rhs,
+                                               Compare compare)
+            -> void
+        {
+            auto lhs_value = *lhs;
+            auto rhs_value = *rhs;
+            bool do_swap = compare(rhs_value, lhs_value);
+            *lhs = do_swap ? rhs_value : lhs_value;
+            *rhs = do_swap ? lhs_value : rhs_value;
+            record_moves(2);
+        }
+
+        // Batcher's odd-even merge sort for any number of elements: the
+        // sequence of compare-exchanges only depends on N, so it can be
+        // computed at compile time and fully unrolled, which gives a sort
+        // without any data-dependent branch
+
+        constexpr auto sorting_network_size(std::size_t size) noexcept
+            -> std::size_t
+        {
+            std::size_t res = 0;
+            for (std::size_t p = 1 ; p < size ; p <<= 1) {
+                for (std::size_t k = p ; k != 0 ; k >>= 1) {
+                    for (std::size_t j = k % p ; j + k < size ; j += 2 * k) {
+                        for (std::size_t i = 0 ; i < k && i + j + k < size ; ++i) {
+                            if ((i + j) / (2 * p) == (i + j + k) / (2 * p)) {
+                                ++res;
+                            }
+                        }
+                    }
+                }
+            }
+            return res;
+        }
+
+        template<std::size_t N>
+        struct sorting_network_pairs
+        {
+            // One more element to avoid zero-sized arrays
+            std::size_t lhs[sorting_network_size(N) + 1] = {};
+            std::size_t rhs[sorting_network_size(N) + 1] = {};
+
+            constexpr sorting_network_pairs() noexcept
+            {
+                std::size_t idx = 0;
+                for (std::size_t p = 1 ; p < N ; p <<= 1) {
+                    for (std::size_t k = p ; k != 0 ; k >>= 1) {
+                        for (std::size_t j = k % p ; j + k < N ; j += 2 * k) {
+                            for (std::size_t i = 0 ; i < k && i + j + k < N ; ++i) {
+                                if ((i + j) / (2 * p) == (i + j + k) / (2 * p)) {
+                                    lhs[idx] = i + j;
+                                    rhs[idx] = i + j + k;
+                                    ++idx;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        };
+
+        template<std::size_t N, typename RandomAccessIterator,
+                 typename Compare, std::size_t... Indices>
+        POPLAR_CONSTEXPR auto sorting_network(RandomAccessIterator first, Compare compare,
+                                              std::index_sequence<Indices...>)
+            -> void
+        {
+            (void) first;
+            (void) compare;
+
+            constexpr sorting_network_pairs<N> pairs;
+            using expand = int[];
+            (void) expand { 0, (
+                compare_exchange(first + pairs.lhs[Indices], first + pairs.rhs[Indices], compare),
+                0
+            )... };
+        }
+
+        template<std::size_t N, typename RandomAccessIterator, typename Compare>
+        POPLAR_CONSTEXPR auto sorting_network(RandomAccessIterator first, Compare compare)
+            -> void
+        {
+            sorting_network<N>(std::move(first), std::move(compare),
+                               std::make_index_sequence<sorting_network_size(N)>{});
+        }
+
+        // Sorting networks beat insertion sort on random data for small
+        // arrays of arithmetic types, but they grow too fast to be worth
+        // it beyond a few dozen elements
+        template<typename T, std::size_t N>
+        using use_sorting_network = std::integral_constant<
+            bool,
+            std::is_arithmetic<T>::value && N <= 31
+        >;
+
+        template<std::size_t N, typename RandomAccessIterator, typename Compare>
+        POPLAR_CONSTEXPR auto make_small_poplar(RandomAccessIterator first, Compare compare,
+                                                std::true_type)
+            -> void
+        {
+            sorting_network<N>(std::move(first), std::move(compare));
+        }
+
+        template<std::size_t N, typename RandomAccessIterator, typename Compare>
+        POPLAR_CONSTEXPR auto make_small_poplar(RandomAccessIterator first, Compare compare,
+                                                std::false_type)
+            -> void
+        {
+            unchecked_insertion_sort(first, first + N, std::move(compare));
+        }
+
+        // Sorts N elements to make a poplar
+        template<std::size_t N, typename RandomAccessIterator, typename Compare>
+        POPLAR_CONSTEXPR auto make_small_poplar(RandomAccessIterator first, Compare compare)
+            -> void
+        {
+            using value_type = typename std::iterator_traits<RandomAccessIterator>::value_type;
+            make_small_poplar<N>(std::move(first), std::move(compare),
+                                 use_sorting_network<value_type, N>{});
+        }
+
         ////////////////////////////////////////////////////////////
         // Poplar heap specific helper functions
         ////////////////////////////////////////////////////////////
 
         template<typename RandomAccessIterator, typename Size, typename Compare>
-        auto sift(RandomAccessIterator first, Size size, Compare compare)
+        POPLAR_CONSTEXPR auto sift(RandomAccessIterator first, Size size, Compare compare)
             -> void
         {
+            sift_recorder recorder;
             if (size < 2) return;
 
             auto root = first + (size - 1);
@@ -145,6 +564,8 @@ namespace poplar
 
                 using std::swap;
                 swap(*root, *max_root);
+                record_swaps(1);
+                recorder.level();
 
                 size /= 2;
                 if (size < 2) return;
@@ -156,64 +577,783 @@ namespace poplar
         }
 
         template<typename RandomAccessIterator, typename Size, typename Compare>
-        auto pop_heap_with_size(RandomAccessIterator first, RandomAccessIterator last,
-                                Size size, Size poplar_size, Compare compare)
+        POPLAR_CONSTEXPR auto sift(RandomAccessIterator first, Size size, Compare compare, swap_sift_t)
+            -> void
+        {
+            sift(std::move(first), size, std::move(compare));
+        }
+
+        template<typename RandomAccessIterator, typename Size, typename Compare>
+        POPLAR_CONSTEXPR auto sift(RandomAccessIterator first, Size size, Compare compare, hole_sift_t)
+            -> void
+        {
+            sift_recorder recorder;
+            if (size < 2) return;
+
+            auto root = first + (size - 1);
+            auto child_root1 = root - 1;
+            auto child_root2 = first + (size / 2 - 1);
+            auto max_root = compare(*child_root1, *child_root2) ? child_root2 : child_root1;
+            if (!compare(*root, *max_root)) return;
+
+            auto tmp = std::move(*root);
+            do {
+                *root = std::move(*max_root);
+                root = max_root;
+                record_moves(1);
+                recorder.level();
+
+                size /= 2;
+                if (size < 2) break;
+
+                child_root1 = root - 1;
+                child_root2 = root - (size - size / 2);
+                max_root = compare(*child_root1, *child_root2) ? child_root2 : child_root1;
+            } while (compare(tmp, *max_root));
+            *root = std::move(tmp);
+            record_moves(2);
+        }
+
+        // Prefetches the root of the first subpoplar of a poplar; the
+        // root of the second one is right before the poplar root, which
+        // is generally already in the cache when we get there
+        template<typename RandomAccessIterator, typename Size>
+        auto prefetch_child_root(RandomAccessIterator root, Size size)
+            -> void
+        {
+            if (size < 3) return;
+            prefetch(root - (size - size / 2));
+        }
+
+        template<typename RandomAccessIterator, typename Size, typename Compare>
+        auto sift(RandomAccessIterator first, Size size, Compare compare, prefetch_sift_t)
+            -> void
+        {
+            sift_recorder recorder;
+            if (size < 2) return;
+
+            auto root = first + (size - 1);
+            auto child_root1 = root - 1;
+            auto child_root2 = first + (size / 2 - 1);
+            prefetch_child_root(child_root1, size / 2);
+            prefetch_child_root(child_root2, size / 2);
+            auto max_root = compare(*child_root1, *child_root2) ? child_root2 : child_root1;
+            if (!compare(*root, *max_root)) return;
+
+            auto tmp = std::move(*root);
+            do {
+                *root = std::move(*max_root);
+                root = max_root;
+                record_moves(1);
+                recorder.level();
+
+                size /= 2;
+                if (size < 2) break;
+
+                child_root1 = root - 1;
+                child_root2 = root - (size - size / 2);
+                prefetch_child_root(child_root1, size / 2);
+                prefetch_child_root(child_root2, size / 2);
+                max_root = compare(*child_root1, *child_root2) ? child_root2 : child_root1;
+            } while (compare(tmp, *max_root));
+            *root = std::move(tmp);
+            record_moves(2);
+        }
+
+        template<typename RandomAccessIterator, typename Size, typename Compare>
+        POPLAR_CONSTEXPR auto sift(RandomAccessIterator first, Size size, Compare compare,
+                                   default_sift_t)
+            -> void
+        {
+            using value_type = typename std::iterator_traits<RandomAccessIterator>::value_type;
+            using policy = std::conditional_t<
+                use_hole_sift<value_type>::value,
+                hole_sift_t,
+                swap_sift_t
+            >;
+            sift(std::move(first), size, std::move(compare), policy{});
+        }
+
+        template<typename RandomAccessIterator, typename Size, typename Compare>
+        POPLAR_CONSTEXPR auto sift(RandomAccessIterator first, Size size, Compare compare,
+                                   bottom_up_sift_t)
             -> void
+        {
+            sift_recorder recorder;
+            if (size < 2) return;
+
+            // Go down to a leaf following the bigger children roots, and
+            // remember the path: every set bit means that we went down to
+            // the root of the first subpoplar, every unset bit that we
+            // went down to the root of the second one
+            auto root = first + (size - 1);
+            auto node = root;
+            Size path = 0;
+            Size depth = 0;
+            Size poplar_size = size;
+            do {
+                auto child_root1 = node - 1;
+                auto child_root2 = node - (poplar_size - poplar_size / 2);
+                path <<= 1;
+                if (compare(*child_root1, *child_root2)) {
+                    node = child_root2;
+                    path |= 1u;
+                } else {
+                    node = child_root1;
+                }
+                poplar_size /= 2;
+                ++depth;
+            } while (poplar_size >= 2);
+
+            // Climb back until we find an element bigger than the root
+            auto level = depth;
+            for (auto up_path = path ; !compare(*root, *node) ; up_path >>= 1) {
+                node += (up_path & 1u) ? poplar_size + 1 : 1;
+                poplar_size = 2 * poplar_size + 1;
+                if (--level == 0) return;
+            }
+
+            // Move the elements of the path up by one level and put
+            // the former root where the hole ends up
+            auto tmp = std::move(*root);
+            auto hole = root;
+            poplar_size = size;
+            for (auto bit = Size(1) << (depth - 1) ; level != 0 ; bit >>= 1, --level) {
+                auto child = (path & bit) ? hole - (poplar_size - poplar_size / 2) : hole - 1;
+                *hole = std::move(*child);
+                hole = child;
+                poplar_size /= 2;
+                record_moves(1);
+                recorder.level();
+            }
+            *hole = std::move(tmp);
+            record_moves(2);
+        }
+
+        // Called by bigger_root with every poplar root and the size of
+        // its poplar as soon as its position is known, which is one step
+        // before the root is compared; prefetch_sift uses it to load the
+        // roots and their subpoplar roots ahead of the scan and the sift
+
+        struct no_root_prefetch
+        {
+            template<typename RandomAccessIterator, typename Size>
+            constexpr auto operator()(RandomAccessIterator, Size) const
+                -> void
+            {}
+        };
+
+        struct root_prefetch
+        {
+            template<typename RandomAccessIterator, typename Size>
+            auto operator()(RandomAccessIterator root, Size size) const
+                -> void
+            {
+                prefetch(root);
+                prefetch_child_root(root, size);
+            }
+        };
+
+        // Finds the bigger poplar root, returns the root and the size
+        // of the corresponding poplar
+        template<typename RandomAccessIterator, typename Size,
+                 typename Compare, typename RootPrefetch=no_root_prefetch>
+        POPLAR_CONSTEXPR auto bigger_root(RandomAccessIterator first, RandomAccessIterator last,
+                                          Size size, Size poplar_size, Compare compare,
+                                          std::false_type, RootPrefetch prefetch_roots={})
+            -> std::pair<RandomAccessIterator, Size>
         {
             auto last_root = std::prev(last);
             auto bigger = last_root;
             auto bigger_size = poplar_size;
 
-            // Look for the bigger poplar root
             auto it = first;
+            prefetch_roots(std::next(it, poplar_size - 1), poplar_size);
             while (true) {
                 auto root = std::next(it, poplar_size - 1);
                 if (root == last_root) break;
+                auto root_size = poplar_size;
+                it = std::next(root);
+
+                size -= poplar_size;
+                poplar_size = unguarded_bit_floor(size + 1u) - 1u;
+                prefetch_roots(std::next(it, poplar_size - 1), poplar_size);
+
                 if (compare(*bigger, *root)) {
                     bigger = root;
-                    bigger_size = poplar_size;
+                    bigger_size = root_size;
                 }
-                it = std::next(root);
+            }
+            if (bigger == last_root) {
+                bigger_size = poplar_size;
+            }
+            return { bigger, bigger_size };
+        }
+
+        // Tells whether compare orders the elements of type T through
+        // keys of an arithmetic type, which is the case of std::less and
+        // std::greater on arithmetic types, so that the branchless paths
+        // can work on copies of those keys: key extracts the key of an
+        // element, and compare_keys compares two keys. Comparators that
+        // project the elements onto such keys can specialize it
+        template<typename Compare, typename T, typename = void>
+        struct branchless_compare_traits:
+            std::false_type
+        {};
+
+        template<typename Compare, typename T>
+        struct branchless_compare_traits<
+            Compare, T,
+            std::enable_if_t<std::is_arithmetic<T>::value && (
+                std::is_same<Compare, std::less<>>::value ||
+                std::is_same<Compare, std::greater<>>::value ||
+                std::is_same<Compare, std::less<T>>::value ||
+                std::is_same<Compare, std::greater<T>>::value
+            )>
+        >:
+            std::true_type
+        {
+            using key_type = T;
+
+            static constexpr auto key(Compare&, const T& value)
+                -> key_type
+            {
+                return value;
+            }
+
+            static constexpr auto compare_keys(Compare& compare, key_type lhs, key_type rhs)
+                -> bool
+            {
+                return compare(lhs, rhs);
+            }
+        };
+
+        // Same as the bigger_root above for comparators satisfying
+        // branchless_compare_traits: the key of the bigger root is tracked
+        // with conditional moves instead of hard to predict compare-and-
+        // branch steps
+        template<typename RandomAccessIterator, typename Size,
+                 typename Compare, typename RootPrefetch=no_root_prefetch>
+        POPLAR_CONSTEXPR auto bigger_root(RandomAccessIterator first, RandomAccessIterator last,
+                                          Size size, Size poplar_size, Compare compare,
+                                          std::true_type, RootPrefetch prefetch_roots={})
+            -> std::pair<RandomAccessIterator, Size>
+        {
+            using difference_type = typename std::iterator_traits<RandomAccessIterator>::difference_type;
+            using traits = branchless_compare_traits<
+                Compare,
+                typename std::iterator_traits<RandomAccessIterator>::value_type
+            >;
+
+            auto last_root = std::prev(last);
+            auto bigger_key = traits::key(compare, *last_root);
+            difference_type bigger_offset = std::distance(first, last_root);
+            Size bigger_size = poplar_size;
 
+            difference_type root_offset = -1;
+            prefetch_roots(first + (poplar_size - 1), poplar_size);
+            while (true) {
+                root_offset += poplar_size;
                 size -= poplar_size;
+                if (size == 0) break;
+                auto root_size = poplar_size;
+
                 poplar_size = unguarded_bit_floor(size + 1u) - 1u;
+                prefetch_roots(first + (root_offset + poplar_size), poplar_size);
+
+                auto root_key = traits::key(compare, first[root_offset]);
+                bool is_bigger = traits::compare_keys(compare, bigger_key, root_key);
+                bigger_key = is_bigger ? root_key : bigger_key;
+                bigger_offset = is_bigger ? root_offset : bigger_offset;
+                bigger_size = is_bigger ? root_size : bigger_size;
             }
+            bigger_size = bigger_offset == root_offset ? poplar_size : bigger_size;
+            return { first + bigger_offset, bigger_size };
+        }
+
+        template<typename RandomAccessIterator, typename Compare>
+        using use_branchless_root_scan = branchless_compare_traits<
+            Compare,
+            typename std::iterator_traits<RandomAccessIterator>::value_type
+        >;
+
+        template<typename RandomAccessIterator, typename Size,
+                 typename Compare, typename RootPrefetch=no_root_prefetch>
+        POPLAR_CONSTEXPR auto bigger_root(RandomAccessIterator first, RandomAccessIterator last,
+                                          Size size, Size poplar_size, Compare compare,
+                                          RootPrefetch prefetch_roots={})
+            -> std::pair<RandomAccessIterator, Size>
+        {
+            return bigger_root(std::move(first), std::move(last), size, poplar_size,
+                               std::move(compare),
+                               use_branchless_root_scan<RandomAccessIterator, Compare>{},
+                               prefetch_roots);
+        }
 
+        // Exchanges the bigger poplar root with the last element of
+        // the poplar heap and sifts it into its new poplar
+        template<typename RandomAccessIterator, typename Size,
+                 typename Compare, typename SiftPolicy>
+        POPLAR_CONSTEXPR auto pop_bigger_root(RandomAccessIterator last, RandomAccessIterator bigger,
+                                              Size bigger_size, Compare compare, SiftPolicy policy)
+            -> void
+        {
             // If a poplar root was bigger than the last one, exchange
             // them and sift
+            auto last_root = std::prev(last);
             if (bigger != last_root) {
                 std::iter_swap(bigger, last_root);
-                sift(bigger - (bigger_size - 1), bigger_size, std::move(compare));
+                record_swaps(1);
+                sift(bigger - (bigger_size - 1), bigger_size, std::move(compare), policy);
             }
         }
-    }
-
-    ////////////////////////////////////////////////////////////
-    // Standard-library-style make_heap and sort_heap
-    ////////////////////////////////////////////////////////////
-
-    template<typename RandomAccessIterator, typename Compare=std::less<>>
-    auto push_heap(RandomAccessIterator first, RandomAccessIterator last, Compare compare={})
-        -> void
-    {
-        using poplar_size_t = std::make_unsigned_t<
-            typename std::iterator_traits<RandomAccessIterator>::difference_type
-        >;
-        poplar_size_t size = std::distance(first, last);
 
-        // Find the size of the poplar that will contain the new element in O(log n)
-        poplar_size_t last_poplar_size = detail::bit_floor(size + 1u) - 1u;
-        while (size - last_poplar_size != 0) {
-            size -= last_poplar_size;
-            last_poplar_size = detail::unguarded_bit_floor(size + 1u) - 1u;
+        template<typename RandomAccessIterator, typename Size,
+                 typename Compare, typename SiftPolicy>
+        POPLAR_CONSTEXPR auto pop_heap_with_size(RandomAccessIterator first, RandomAccessIterator last,
+                                                 Size size, Size poplar_size, Compare compare,
+                                                 SiftPolicy policy)
+            -> void
+        {
+            auto bigger = bigger_root(first, last, size, poplar_size, compare);
+            pop_bigger_root(std::move(last), bigger.first, bigger.second,
+                            std::move(compare), policy);
         }
 
-        // Sift the new element in its poplar in O(log n)
-        detail::sift(std::prev(last, last_poplar_size), last_poplar_size, std::move(compare));
-    }
-
-    template<typename RandomAccessIterator, typename Compare=std::less<>>
-    auto pop_heap(RandomAccessIterator first, RandomAccessIterator last, Compare compare={})
+        // Prefetches every poplar root one step ahead of the scan, as
+        // well as the root of its first subpoplar for the sift that
+        // follows, so that the cache misses overlap the comparisons
+        template<typename RandomAccessIterator, typename Size, typename Compare>
+        auto pop_heap_with_size(RandomAccessIterator first, RandomAccessIterator last,
+                                Size size, Size poplar_size, Compare compare,
+                                prefetch_sift_t policy)
+            -> void
+        {
+            auto bigger = bigger_root(first, last, size, poplar_size, compare, root_prefetch{});
+            pop_bigger_root(std::move(last), bigger.first, bigger.second,
+                            std::move(compare), policy);
+        }
+
+        // Builds a poplar of the given size in a top-down fashion: the
+        // subpoplars are built recursively, then the root is sifted
+        template<typename RandomAccessIterator, typename Size,
+                 typename Compare, typename SiftPolicy>
+        POPLAR_CONSTEXPR auto make_poplar(RandomAccessIterator first, Size size, Compare compare,
+                                          SiftPolicy policy)
+            -> void
+        {
+            using value_type = typename std::iterator_traits<RandomAccessIterator>::value_type;
+            constexpr std::size_t base_size = poplar::small_poplar_size<value_type>::value;
+            static_assert(base_size != 0 && (base_size & (base_size + 1)) == 0,
+                          "small_poplar_size must be of the form 2^n-1");
+
+            if (size == base_size) {
+                make_small_poplar<base_size>(std::move(first), std::move(compare));
+                return;
+            }
+            if (size < base_size) {
+                insertion_sort(first, first + size, std::move(compare));
+                return;
+            }
+
+            make_poplar(first, size / 2, compare, policy);
+            make_poplar(first + size / 2, size / 2, compare, policy);
+            sift(std::move(first), size, std::move(compare), policy);
+        }
+
+        ////////////////////////////////////////////////////////////
+        // Adaptive sort helpers
+        ////////////////////////////////////////////////////////////
+
+        // Compares elements in reverse order, used to find descending runs
+        template<typename Compare>
+        struct reverse_compare
+        {
+            Compare& compare;
+
+            template<typename T, typename U>
+            POPLAR_CONSTEXPR auto operator()(T&& lhs, U&& rhs)
+                -> bool
+            {
+                return compare(std::forward<U>(rhs), std::forward<T>(lhs));
+            }
+        };
+
+        // Merges the sorted ranges [first, middle) and [middle, last) in
+        // place with rotations, without any extra memory; the elements
+        // already in their final place at both ends are skipped with a
+        // binary search, so appending a few elements bigger than most of
+        // the first range to it is cheap. Recursing on the smaller half
+        // only bounds the recursion depth to O(log n)
+        template<typename RandomAccessIterator, typename Compare>
+        POPLAR_CONSTEXPR auto merge_without_buffer(RandomAccessIterator first,
+                                                   RandomAccessIterator middle,
+                                                   RandomAccessIterator last,
+                                                   Compare compare)
+            -> void
+        {
+            while (first != middle && middle != last) {
+                first = std::upper_bound(first, middle, *middle, compare);
+                if (first == middle) return;
+                last = std::lower_bound(middle, last, *std::prev(middle), compare);
+                if (middle == last) return;
+
+                auto size1 = std::distance(first, middle);
+                auto size2 = std::distance(middle, last);
+                if (size1 == 1 && size2 == 1) {
+                    std::iter_swap(first, middle);
+                    record_swaps(1);
+                    return;
+                }
+
+                RandomAccessIterator cut1, cut2;
+                if (size1 > size2) {
+                    cut1 = first + size1 / 2;
+                    cut2 = std::lower_bound(middle, last, *cut1, compare);
+                } else {
+                    cut2 = middle + size2 / 2;
+                    cut1 = std::upper_bound(first, middle, *cut2, compare);
+                }
+                auto new_middle = std::rotate(cut1, middle, cut2);
+
+                if (std::distance(first, new_middle) < std::distance(new_middle, last)) {
+                    merge_without_buffer(first, cut1, new_middle, compare);
+                    first = new_middle;
+                    middle = cut2;
+                } else {
+                    merge_without_buffer(new_middle, cut2, last, compare);
+                    last = new_middle;
+                    middle = cut1;
+                }
+            }
+        }
+
+        ////////////////////////////////////////////////////////////
+        // Poplar layout
+        ////////////////////////////////////////////////////////////
+
+        // Explicit representation of the poplars of a poplar heap: a
+        // poplar of size 2^k-1 is represented by the bit 2^(k-1) in
+        // mask, and the doubled flag tells whether the smallest poplar
+        // appears twice, which is the only way for two poplars of the
+        // same size to coexist in a poplar heap. Keeping it around
+        // allows to update the decomposition in O(1) when an element
+        // is added or removed at the end of the poplar heap
+
+        template<typename Size>
+        struct poplar_layout
+        {
+            Size mask = 0;
+            bool doubled = false;
+
+            constexpr poplar_layout() noexcept = default;
+
+            // Computes the layout of a poplar heap of the given size
+            explicit constexpr poplar_layout(Size size) noexcept
+            {
+                if (size == 0) return;
+                Size poplar_size = bit_floor(size + 1u) - 1u;
+                while (true) {
+                    Size bit = poplar_size / 2 + 1;
+                    doubled = (mask & bit) != 0;
+                    mask |= bit;
+
+                    size -= poplar_size;
+                    if (size == 0) return;
+                    poplar_size = unguarded_bit_floor(size + 1u) - 1u;
+                }
+            }
+
+            constexpr auto empty() const noexcept
+                -> bool
+            {
+                return mask == 0;
+            }
+
+            // Size of the poplar that contains the last element, assumes
+            // that the layout is not empty
+            constexpr auto last_poplar_size() const noexcept
+                -> Size
+            {
+                return 2 * (mask & -mask) - 1;
+            }
+
+            // Updates the layout after an element was added at the end
+            // of the poplar heap, returns the size of the poplar whose
+            // root is the new element
+            constexpr auto push_back() noexcept
+                -> Size
+            {
+                if (doubled) {
+                    // The two smallest poplars and the new element
+                    // are fused into a bigger poplar
+                    Size bit = mask & -mask;
+                    mask ^= bit;
+                    bit <<= 1;
+                    doubled = (mask & bit) != 0;
+                    mask |= bit;
+                    return 2 * bit - 1;
+                }
+                doubled = (mask & 1u) != 0;
+                mask |= 1u;
+                return 1;
+            }
+
+            // Tells whether a whole poplar of the given size can be
+            // added at the end of the poplar heap without changing
+            // the layout of the elements before it
+            constexpr auto can_push_back_poplar(Size poplar_size) const noexcept
+                -> bool
+            {
+                return !doubled && (empty() || last_poplar_size() >= poplar_size);
+            }
+
+            // Updates the layout after a whole poplar of the given size
+            // was added at the end of the poplar heap, assumes that
+            // can_push_back_poplar(poplar_size) is true
+            constexpr auto push_back_poplar(Size poplar_size) noexcept
+                -> void
+            {
+                Size bit = poplar_size / 2 + 1;
+                doubled = (mask & bit) != 0;
+                mask |= bit;
+            }
+
+            // Updates the layout after the last element of the poplar
+            // heap, which is always a poplar root, was removed
+            constexpr auto pop_back() noexcept
+                -> void
+            {
+                Size bit = mask & -mask;
+                if (!doubled) {
+                    mask ^= bit;
+                }
+                // The subpoplars of the removed root become poplars
+                doubled = bit != 1;
+                mask |= bit >> 1;
+            }
+        };
+
+        // Finds the bigger poplar root by walking the roots from last
+        // to first with the help of the explicit layout instead of
+        // recomputing the size of every poplar, returns the root and
+        // the size of the corresponding poplar
+        template<typename RandomAccessIterator, typename Size, typename Compare>
+        POPLAR_CONSTEXPR auto bigger_root(RandomAccessIterator last, poplar_layout<Size> layout,
+                                          Compare compare)
+            -> std::pair<RandomAccessIterator, Size>
+        {
+            auto root = std::prev(last);
+            auto bigger = root;
+
+            Size mask = layout.mask;
+            Size bit = mask & -mask;
+            Size poplar_size = 2 * bit - 1;
+            Size bigger_size = poplar_size;
+
+            while (true) {
+                if (layout.doubled) {
+                    // The previous poplar has the same size
+                    layout.doubled = false;
+                } else {
+                    mask ^= bit;
+                    if (mask == 0) break;
+                    bit = mask & -mask;
+                }
+                root -= poplar_size;
+                poplar_size = 2 * bit - 1;
+                if (compare(*bigger, *root)) {
+                    bigger = root;
+                    bigger_size = poplar_size;
+                }
+            }
+            return { bigger, bigger_size };
+        }
+
+        // Layout of a poplar heap along with the position of its bigger
+        // root and the size of the poplar of that root, maintained by
+        // the priority queues so that top is O(1) and pop doesn't have
+        // to look for the bigger root again. The positions are relative
+        // to the first element of the heap
+        template<typename Size>
+        struct heap_tracker
+        {
+            poplar_layout<Size> layout;
+            // Only meaningful when the heap is not empty
+            Size max_root = 0;
+            Size max_root_size = 0;
+
+            // Computes everything from the poplar heap [first, first + size)
+            template<typename RandomAccessIterator, typename Compare>
+            POPLAR_CONSTEXPR auto reset(RandomAccessIterator first, Size size, Compare& compare)
+                -> void
+            {
+                layout = poplar_layout<Size>(size);
+                find_max_root(std::move(first), size, compare);
+            }
+
+            // Adds an element at the end of the layout and returns the
+            // size of the poplar it is the root of, which has to be
+            // sifted before calling pushed
+            POPLAR_CONSTEXPR auto push_back() noexcept
+                -> Size
+            {
+                return layout.push_back();
+            }
+
+            template<typename RandomAccessIterator, typename Compare>
+            POPLAR_CONSTEXPR auto pushed(RandomAccessIterator first, Size new_root,
+                                         Size poplar_size, Compare& compare)
+                -> void
+            {
+                // The new poplar root might be the new bigger root, and
+                // it definitely is if it was made from the poplar that
+                // contained the previous bigger root
+                if (std::size_t(max_root) + poplar_size > std::size_t(new_root) ||
+                    compare(first[max_root], first[new_root])) {
+                    max_root = new_root;
+                    max_root_size = poplar_size;
+                }
+            }
+
+            // Removes the last element of the layout once the bigger root
+            // was popped, the heap now being [first, first + size)
+            template<typename RandomAccessIterator, typename Compare>
+            POPLAR_CONSTEXPR auto pop_back(RandomAccessIterator first, Size size, Compare& compare)
+                -> void
+            {
+                layout.pop_back();
+                find_max_root(std::move(first), size, compare);
+            }
+
+            template<typename RandomAccessIterator, typename Compare>
+            POPLAR_CONSTEXPR auto find_max_root(RandomAccessIterator first, Size size,
+                                                Compare& compare)
+                -> void
+            {
+                if (size == 0) return;
+                auto bigger = bigger_root(first + size, layout, compare);
+                max_root = static_cast<Size>(bigger.first - first);
+                max_root_size = bigger.second;
+            }
+        };
+
+        // Appends the poplar of the given size starting at first to the
+        // poplar heap described by layout, which ends right before first:
+        // the poplar is kept as is when the layout allows it, otherwise
+        // its subpoplars are appended first and its root is pushed
+        template<typename RandomAccessIterator, typename Size,
+                 typename Compare, typename SiftPolicy>
+        POPLAR_CONSTEXPR auto append_poplar(RandomAccessIterator first, Size poplar_size,
+                                            poplar_layout<Size>& layout, Compare compare,
+                                            SiftPolicy policy)
+            -> void
+        {
+            if (layout.can_push_back_poplar(poplar_size)) {
+                layout.push_back_poplar(poplar_size);
+                return;
+            }
+
+            if (poplar_size > 1) {
+                Size child_size = poplar_size / 2;
+                append_poplar(first, child_size, layout, compare, policy);
+                append_poplar(first + child_size, child_size, layout, compare, policy);
+            }
+            auto root = first + (poplar_size - 1);
+            Size root_poplar_size = layout.push_back();
+            sift(root - (root_poplar_size - 1), root_poplar_size, std::move(compare), policy);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Standard-library-style make_heap and sort_heap
+    ////////////////////////////////////////////////////////////
+
+    template<
+        typename RandomAccessIterator,
+        typename Compare = std::less<>,
+        typename SiftPolicy = default_sift_t
+    >
+    POPLAR_CONSTEXPR auto push_heap(RandomAccessIterator first, RandomAccessIterator last,
+                                    Compare compare={}, SiftPolicy policy={})
+        -> void
+    {
+        using poplar_size_t = std::make_unsigned_t<
+            typename std::iterator_traits<RandomAccessIterator>::difference_type
+        >;
+        poplar_size_t size = std::distance(first, last);
+
+        // Find the size of the poplar that will contain the new element in O(log n)
+        poplar_size_t last_poplar_size = detail::bit_floor(size + 1u) - 1u;
+        while (size - last_poplar_size != 0) {
+            size -= last_poplar_size;
+            last_poplar_size = detail::unguarded_bit_floor(size + 1u) - 1u;
+        }
+
+        // Sift the new element in its poplar in O(log n)
+        detail::sift(std::prev(last, last_poplar_size), last_poplar_size,
+                     std::move(compare), policy);
+    }
+
+    // Inserts the elements of [middle, last) into the poplar heap
+    // [first, middle): the layout of the poplar heap is computed once
+    // and updated in O(1) for every new element, which only needs to
+    // be sifted when it fuses poplars, as in make_heap
+    template<
+        typename RandomAccessIterator,
+        typename Compare = std::less<>,
+        typename SiftPolicy = default_sift_t
+    >
+    POPLAR_CONSTEXPR auto push_heap(RandomAccessIterator first, RandomAccessIterator middle,
+                                    RandomAccessIterator last, Compare compare={}, SiftPolicy policy={})
+        -> void
+    {
+        using poplar_size_t = std::make_unsigned_t<
+            typename std::iterator_traits<RandomAccessIterator>::difference_type
+        >;
+        detail::poplar_layout<poplar_size_t> layout(std::distance(first, middle));
+        for (; middle != last ; ++middle) {
+            poplar_size_t poplar_size = layout.push_back();
+            if (poplar_size > 1) {
+                detail::sift(middle - (poplar_size - 1), poplar_size, compare, policy);
+            }
+        }
+    }
+
+    // Merges the adjacent poplar heaps [first, middle) and [middle, last)
+    // into a single poplar heap: the poplars of the second heap are kept
+    // whole whenever possible, and only the roots of those that need to
+    // be split in order to fit the layout of the new heap are sifted
+    template<
+        typename RandomAccessIterator,
+        typename Compare = std::less<>,
+        typename SiftPolicy = default_sift_t
+    >
+    POPLAR_CONSTEXPR auto merge_heaps(RandomAccessIterator first, RandomAccessIterator middle,
+                                      RandomAccessIterator last, Compare compare={},
+                                      SiftPolicy policy={})
+        -> void
+    {
+        using poplar_size_t = std::make_unsigned_t<
+            typename std::iterator_traits<RandomAccessIterator>::difference_type
+        >;
+        detail::poplar_layout<poplar_size_t> layout(std::distance(first, middle));
+        poplar_size_t size = std::distance(middle, last);
+        while (size != 0) {
+            poplar_size_t poplar_size = detail::unguarded_bit_floor(size + 1u) - 1u;
+            detail::append_poplar(middle, poplar_size, layout, compare, policy);
+            middle += poplar_size;
+            size -= poplar_size;
+        }
+    }
+
+    template<
+        typename RandomAccessIterator,
+        typename Compare = std::less<>,
+        typename SiftPolicy = default_sift_t
+    >
+    POPLAR_CONSTEXPR auto pop_heap(RandomAccessIterator first, RandomAccessIterator last,
+                                   Compare compare={}, SiftPolicy policy={})
         -> void
     {
         using poplar_size_t = std::make_unsigned_t<
@@ -222,11 +1362,108 @@ namespace poplar
         poplar_size_t size = std::distance(first, last);
         auto poplar_size = detail::bit_floor(size + 1u) - 1u;
         detail::pop_heap_with_size(std::move(first), std::move(last),
-                                   size, poplar_size, std::move(compare));
+                                   size, poplar_size, std::move(compare), policy);
     }
 
-    template<typename RandomAccessIterator, typename Compare=std::less<>>
-    auto make_heap(RandomAccessIterator first, RandomAccessIterator last, Compare compare={})
+    // Restores the poplar heap property of [first, last) after the
+    // value at pos was changed: a value that became bigger than its
+    // parent is moved up towards the root of its poplar, otherwise it
+    // is sifted down its subpoplar. The roots of the poplars are not
+    // ordered, so the other poplars are never affected
+    template<
+        typename RandomAccessIterator,
+        typename Compare = std::less<>,
+        typename SiftPolicy = default_sift_t
+    >
+    POPLAR_CONSTEXPR auto update_heap(RandomAccessIterator first, RandomAccessIterator last,
+                                      RandomAccessIterator pos, Compare compare={}, SiftPolicy policy={})
+        -> void
+    {
+        using poplar_size_t = std::make_unsigned_t<
+            typename std::iterator_traits<RandomAccessIterator>::difference_type
+        >;
+        poplar_size_t size = std::distance(first, last);
+        poplar_size_t offset = std::distance(first, pos);
+
+        // Find the poplar that contains pos
+        auto poplar_first = first;
+        poplar_size_t poplar_size = detail::bit_floor(size + 1u) - 1u;
+        while (offset >= poplar_size) {
+            poplar_first += poplar_size;
+            offset -= poplar_size;
+            size -= poplar_size;
+            poplar_size = detail::unguarded_bit_floor(size + 1u) - 1u;
+        }
+
+        // Go down to the subpoplar whose root is pos and remember the
+        // path: every set bit means that we went down to the second
+        // subpoplar, every unset bit that we went down to the first one
+        poplar_size_t path = 0;
+        poplar_size_t depth = 0;
+        while (offset != poplar_size - 1) {
+            poplar_size /= 2;
+            path <<= 1;
+            ++depth;
+            if (offset >= poplar_size) {
+                poplar_first += poplar_size;
+                offset -= poplar_size;
+                path |= 1u;
+            }
+        }
+
+        if (depth != 0) {
+            auto parent = pos + ((path & 1u) ? 1 : poplar_size + 1);
+            if (compare(*parent, *pos)) {
+                // Move the parents down by one level until the
+                // place of the value is found
+                auto tmp = std::move(*pos);
+                auto hole = pos;
+                do {
+                    *hole = std::move(*parent);
+                    hole = parent;
+                    detail::record_moves(1);
+                    poplar_size = 2 * poplar_size + 1;
+                    path >>= 1;
+                    if (--depth == 0) break;
+                    parent = hole + ((path & 1u) ? 1 : poplar_size + 1);
+                } while (compare(*parent, tmp));
+                *hole = std::move(tmp);
+                detail::record_moves(2);
+                return;
+            }
+        }
+        detail::sift(poplar_first, poplar_size, std::move(compare), policy);
+    }
+
+    // Moves the value at pos to last - 1 and makes [first, last - 1) a
+    // poplar heap: removing the last element of a poplar heap leaves a
+    // valid poplar heap, so exchanging it with the erased one and then
+    // updating its new position is enough
+    template<
+        typename RandomAccessIterator,
+        typename Compare = std::less<>,
+        typename SiftPolicy = default_sift_t
+    >
+    POPLAR_CONSTEXPR auto erase_heap(RandomAccessIterator first, RandomAccessIterator last,
+                                     RandomAccessIterator pos, Compare compare={}, SiftPolicy policy={})
+        -> void
+    {
+        auto last_element = std::prev(last);
+        if (pos == last_element) return;
+
+        std::iter_swap(pos, last_element);
+        detail::record_swaps(1);
+        poplar::update_heap(std::move(first), std::move(last_element), std::move(pos),
+                            std::move(compare), policy);
+    }
+
+    template<
+        typename RandomAccessIterator,
+        typename Compare = std::less<>,
+        typename SiftPolicy = default_sift_t
+    >
+    POPLAR_CONSTEXPR auto make_heap(RandomAccessIterator first, RandomAccessIterator last,
+                                    Compare compare={}, SiftPolicy policy={})
         -> void
     {
         using poplar_diff_t = std::make_unsigned_t<
@@ -237,10 +1474,15 @@ namespace poplar
         if (size < 2) return;
 
         // A sorted collection is a valid poplar heap; whenever the heap
-        // is small, using insertion sort should be faster, which is why
-        // we start by constructing 15-element poplars instead of 1-element
-        // ones as the base case
-        constexpr poplar_diff_t small_poplar_size = 15;
+        // is small, sorting it should be faster, which is why we start
+        // by constructing 15-element poplars (by default) instead of
+        // 1-element ones as the base case
+        using value_type = typename std::iterator_traits<RandomAccessIterator>::value_type;
+        constexpr std::size_t base_size = poplar::small_poplar_size<value_type>::value;
+        static_assert(base_size != 0 && (base_size & (base_size + 1)) == 0,
+                      "small_poplar_size must be of the form 2^n-1");
+
+        constexpr poplar_diff_t small_poplar_size = base_size;
         if (size <= small_poplar_size) {
             detail::unchecked_insertion_sort(std::move(first), std::move(last),
                                              std::move(compare));
@@ -254,15 +1496,17 @@ namespace poplar
         auto it = first;
         auto next = std::next(it, small_poplar_size);
         while (true) {
-            // Make a 15 element poplar
-            detail::unchecked_insertion_sort(it, next, compare);
+            // Make a small poplar
+            detail::make_small_poplar<base_size>(it, compare);
 
             poplar_diff_t poplar_size = small_poplar_size;
             // Bit trick iterate without actually having to compute log2(poplar_level)
             for (auto i = (poplar_level & -poplar_level) >> 1 ; i != 0 ; i >>= 1) {
+                // Not enough elements left to make a bigger poplar
+                if (next == last) return;
                 it -= poplar_size;
                 poplar_size = 2 * poplar_size + 1;
-                detail::sift(it, poplar_size, compare);
+                detail::sift(it, poplar_size, compare, policy);
                 ++next;
             }
 
@@ -278,8 +1522,17 @@ namespace poplar
         }
     }
 
-    template<typename RandomAccessIterator, typename Compare=std::less<>>
-    auto sort_heap(RandomAccessIterator first, RandomAccessIterator last, Compare compare={})
+    template<typename RandomAccessIterator, typename Compare, typename SiftPolicy>
+    POPLAR_CONSTEXPR auto make_heap(RandomAccessIterator first, RandomAccessIterator last,
+                                    Compare compare, SiftPolicy policy, binary_carry_build_t)
+        -> void
+    {
+        poplar::make_heap(std::move(first), std::move(last), std::move(compare), policy);
+    }
+
+    template<typename RandomAccessIterator, typename Compare, typename SiftPolicy>
+    POPLAR_CONSTEXPR auto make_heap(RandomAccessIterator first, RandomAccessIterator last,
+                                    Compare compare, SiftPolicy policy, top_down_build_t)
         -> void
     {
         using poplar_size_t = std::make_unsigned_t<
@@ -288,17 +1541,277 @@ namespace poplar
         poplar_size_t size = std::distance(first, last);
         if (size < 2) return;
 
+        // Build the final poplars directly without fusion
+        poplar_size_t poplar_size = detail::bit_floor(size + 1u) - 1u;
+        while (true) {
+            detail::make_poplar(first, poplar_size, compare, policy);
+            size -= poplar_size;
+            if (size == 0) return;
+
+            first += poplar_size;
+            poplar_size = detail::unguarded_bit_floor(size + 1u) - 1u;
+        }
+    }
+
+    // Moves the n highest values of the poplar heap [first, last) to
+    // [last - n, last) in ascending order, the remaining elements
+    // forming a poplar heap; in other words, sort_heap stopped after
+    // n steps
+    template<
+        typename RandomAccessIterator,
+        typename Compare = std::less<>,
+        typename SiftPolicy = default_sift_t
+    >
+    POPLAR_CONSTEXPR auto pop_heap_n(RandomAccessIterator first, RandomAccessIterator last,
+                                     typename std::iterator_traits<
+                                         RandomAccessIterator
+                                     >::difference_type n,
+                                     Compare compare={}, SiftPolicy policy={})
+        -> void
+    {
+        using poplar_size_t = std::make_unsigned_t<
+            typename std::iterator_traits<RandomAccessIterator>::difference_type
+        >;
+        poplar_size_t size = std::distance(first, last);
+        if (n <= 0) return;
+
+        // Removing an element only changes the size of the first poplar
+        // when the remaining elements don't fill it anymore, in which
+        // case the new first poplar is its first subpoplar
         auto poplar_size = detail::bit_floor(size + 1u) - 1u;
-        do {
-            detail::pop_heap_with_size(first, last, size, poplar_size, compare);
+        while (true) {
+            detail::pop_heap_with_size(first, last, size, poplar_size, compare, policy);
+            if (--n == 0) return;
             --last;
             --size;
-            poplar_size = detail::unguarded_bit_floor(size + 1u) - 1u;
-        } while (size > 1);
+            if (size < poplar_size) {
+                poplar_size /= 2;
+            }
+        }
+    }
+
+    template<
+        typename RandomAccessIterator,
+        typename Compare = std::less<>,
+        typename SiftPolicy = default_sift_t
+    >
+    POPLAR_CONSTEXPR auto sort_heap(RandomAccessIterator first, RandomAccessIterator last,
+                                    Compare compare={}, SiftPolicy policy={})
+        -> void
+    {
+        using poplar_size_t = std::make_unsigned_t<
+            typename std::iterator_traits<RandomAccessIterator>::difference_type
+        >;
+        poplar_size_t size = std::distance(first, last);
+        if (size < 2) return;
+
+        poplar::pop_heap_n(std::move(first), std::move(last), size - 1,
+                           std::move(compare), policy);
+    }
+
+    // Performs at most budget steps of sort_heap and returns the end of
+    // the remaining poplar heap, the elements after it being sorted:
+    // since the state of the sort is entirely described by the range,
+    // calling it again with the returned iterator as last resumes the
+    // sort, which is complete once it returns first
+    template<
+        typename RandomAccessIterator,
+        typename Compare = std::less<>,
+        typename SiftPolicy = default_sift_t
+    >
+    POPLAR_CONSTEXPR auto sort_heap_step(RandomAccessIterator first, RandomAccessIterator last,
+                                         typename std::iterator_traits<
+                                             RandomAccessIterator
+                                         >::difference_type budget,
+                                         Compare compare={}, SiftPolicy policy={})
+        -> RandomAccessIterator
+    {
+        if (budget <= 0) return last;
+        auto size = std::distance(first, last);
+        if (budget >= size - 1) {
+            poplar::sort_heap(first, std::move(last), std::move(compare), policy);
+            return first;
+        }
+
+        poplar::pop_heap_n(first, last, budget, std::move(compare), policy);
+        return std::prev(last, budget);
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Poplar sort
+    ////////////////////////////////////////////////////////////
+
+    template<
+        typename RandomAccessIterator,
+        typename Compare = std::less<>,
+        typename SiftPolicy = default_sift_t
+    >
+    POPLAR_CONSTEXPR auto sort(RandomAccessIterator first, RandomAccessIterator last,
+                               Compare compare={}, SiftPolicy policy={})
+        -> void
+    {
+        if (std::distance(first, last) < 2) return;
+
+        // Find the sorted prefix, a descending one being reversed
+        auto middle = std::is_sorted_until(first, last, compare);
+        if (middle == std::next(first)) {
+            middle = std::is_sorted_until(first, last, detail::reverse_compare<Compare>{compare});
+            std::reverse(first, middle);
+        }
+        if (middle == last) return;
+
+        // Same for the sorted suffix of what remains, found backwards
+        auto rfirst = std::make_reverse_iterator(last);
+        auto rlast = std::make_reverse_iterator(middle);
+        auto rtail = std::is_sorted_until(rfirst, rlast, detail::reverse_compare<Compare>{compare});
+        if (rtail == std::next(rfirst)) {
+            rtail = std::is_sorted_until(rfirst, rlast, compare);
+            std::reverse(rtail.base(), last);
+        }
+        auto tail = rtail.base();
+
+        // When the sorted prefix and suffix are together at least as
+        // long as the unsorted part between them, only that part is
+        // sorted, recursively so that its own sorted runs are used
+        // too, then the three parts are merged; otherwise the runs are
+        // not worth the merges and the whole range is heap sorted
+        if (std::distance(first, middle) + std::distance(tail, last) >= std::distance(middle, tail)) {
+            poplar::sort(middle, tail, compare, policy);
+            detail::merge_without_buffer(first, middle, tail, compare);
+            detail::merge_without_buffer(std::move(first), std::move(tail),
+                                         std::move(last), std::move(compare));
+            return;
+        }
+        poplar::make_heap(first, last, compare, policy);
+        poplar::sort_heap(std::move(first), std::move(last), std::move(compare), policy);
+    }
+
+    // Keeps the middle - first smallest elements in a poplar heap: every
+    // element of [middle, last) smaller than the highest one in the heap
+    // replaces it and is sifted into its poplar, then the heap is sorted
+    template<
+        typename RandomAccessIterator,
+        typename Compare = std::less<>,
+        typename SiftPolicy = default_sift_t
+    >
+    POPLAR_CONSTEXPR auto partial_sort(RandomAccessIterator first, RandomAccessIterator middle,
+                                       RandomAccessIterator last, Compare compare={},
+                                       SiftPolicy policy={})
+        -> void
+    {
+        using poplar_size_t = std::make_unsigned_t<
+            typename std::iterator_traits<RandomAccessIterator>::difference_type
+        >;
+        poplar_size_t size = std::distance(first, middle);
+        if (size == 0) return;
+
+        poplar::make_heap(first, middle, compare, policy);
+        auto poplar_size = detail::bit_floor(size + 1u) - 1u;
+        auto top = detail::bigger_root(first, middle, size, poplar_size, compare);
+        for (auto it = middle ; it != last ; ++it) {
+            if (compare(*it, *top.first)) {
+                std::iter_swap(it, top.first);
+                detail::record_swaps(1);
+                detail::sift(top.first - (top.second - 1), top.second, compare, policy);
+                top = detail::bigger_root(first, middle, size, poplar_size, compare);
+            }
+        }
+        poplar::sort_heap(std::move(first), std::move(middle), std::move(compare), policy);
+    }
+
+    template<
+        typename InputIterator,
+        typename RandomAccessIterator,
+        typename Compare = std::less<>,
+        typename SiftPolicy = default_sift_t
+    >
+    POPLAR_CONSTEXPR auto partial_sort_copy(InputIterator first, InputIterator last,
+                                            RandomAccessIterator result_first,
+                                            RandomAccessIterator result_last,
+                                            Compare compare={}, SiftPolicy policy={})
+        -> RandomAccessIterator
+    {
+        using poplar_size_t = std::make_unsigned_t<
+            typename std::iterator_traits<RandomAccessIterator>::difference_type
+        >;
+
+        auto result_middle = result_first;
+        for (; first != last && result_middle != result_last ; ++first, ++result_middle) {
+            *result_middle = *first;
+        }
+        poplar_size_t size = std::distance(result_first, result_middle);
+        if (size == 0) return result_middle;
+
+        poplar::make_heap(result_first, result_middle, compare, policy);
+        auto poplar_size = detail::bit_floor(size + 1u) - 1u;
+        auto top = detail::bigger_root(result_first, result_middle, size, poplar_size, compare);
+        for (; first != last ; ++first) {
+            if (compare(*first, *top.first)) {
+                *top.first = *first;
+                detail::record_moves(1);
+                detail::sift(top.first - (top.second - 1), top.second, compare, policy);
+                top = detail::bigger_root(result_first, result_middle, size, poplar_size, compare);
+            }
+        }
+        poplar::sort_heap(result_first, result_middle, std::move(compare), policy);
+        return result_middle;
+    }
+
+    // Sorts [first, last) according to the keys returned by key(value),
+    // which is called once per element: the keys are stored next to the
+    // indices of the elements in a buffer which is sorted instead of the
+    // elements, then the elements are moved to their final position by
+    // following the cycles of the resulting permutation
+    template<
+        typename RandomAccessIterator,
+        typename KeyFunction,
+        typename Compare = std::less<>,
+        typename SiftPolicy = default_sift_t
+    >
+    auto sort_by_key(RandomAccessIterator first, RandomAccessIterator last, KeyFunction key,
+                     Compare compare={}, SiftPolicy policy={})
+        -> void
+    {
+        using difference_type = typename std::iterator_traits<RandomAccessIterator>::difference_type;
+        using key_type = std::decay_t<decltype(key(*first))>;
+        using key_index = std::pair<key_type, difference_type>;
+
+        difference_type size = std::distance(first, last);
+        if (size < 2) return;
+
+        std::vector<key_index> keys;
+        keys.reserve(size);
+        for (difference_type idx = 0 ; idx < size ; ++idx) {
+            keys.emplace_back(key(first[idx]), idx);
+        }
+        poplar::sort(keys.begin(), keys.end(),
+                     [&compare](const key_index& lhs, const key_index& rhs) {
+                         return compare(lhs.first, rhs.first);
+                     },
+                     policy);
+
+        // The element at position keys[idx].second goes to position idx,
+        // positions already handled are marked by setting their index
+        // to themselves
+        for (difference_type idx = 0 ; idx < size ; ++idx) {
+            if (keys[idx].second == idx) continue;
+
+            auto tmp = std::move(first[idx]);
+            auto hole = idx;
+            while (keys[hole].second != idx) {
+                auto next = keys[hole].second;
+                first[hole] = std::move(first[next]);
+                keys[hole].second = hole;
+                hole = next;
+            }
+            first[hole] = std::move(tmp);
+            keys[hole].second = hole;
+        }
     }
 
     template<typename RandomAccessIterator, typename Compare=std::less<>>
-    auto is_heap_until(RandomAccessIterator first, RandomAccessIterator last, Compare compare={})
+    POPLAR_CONSTEXPR auto is_heap_until(RandomAccessIterator first, RandomAccessIterator last,
+                                        Compare compare={})
         -> RandomAccessIterator
     {
         if (std::distance(first, last) < 2) {
@@ -319,6 +1832,8 @@ namespace poplar
 
             // Bit trick iterate without actually having to compute log2(poplar_level)
             for (auto i = (poplar_level & -poplar_level) >> 1 ; i != 0 ; i >>= 1) {
+                if (next == last) return last;
+
                 // Beginning and size of the poplar to track
                 it -= poplar_size;
                 poplar_size = 2 * poplar_size + 1;
@@ -333,8 +1848,6 @@ namespace poplar
                 if (compare(*root, *child_root2)) {
                     return next;
                 }
-
-                if (next == last) return last;
                 ++next;
             }
 
@@ -346,11 +1859,576 @@ namespace poplar
     }
 
     template<typename RandomAccessIterator, typename Compare=std::less<>>
-    auto is_heap(RandomAccessIterator first, RandomAccessIterator last, Compare compare={})
+    POPLAR_CONSTEXPR auto is_heap(RandomAccessIterator first, RandomAccessIterator last,
+                                  Compare compare={})
         -> bool
     {
         return poplar::is_heap_until(first, last, compare) == last;
     }
+
+    template<typename RandomAccessIterator, typename Compare=std::less<>>
+    POPLAR_CONSTEXPR auto heap_top(RandomAccessIterator first, RandomAccessIterator last,
+                                   Compare compare={})
+        -> RandomAccessIterator
+    {
+        using poplar_size_t = std::make_unsigned_t<
+            typename std::iterator_traits<RandomAccessIterator>::difference_type
+        >;
+        poplar_size_t size = std::distance(first, last);
+        if (size < 2) return first;
+
+        auto poplar_size = detail::bit_floor(size + 1u) - 1u;
+        return detail::bigger_root(std::move(first), std::move(last),
+                                   size, poplar_size, std::move(compare)).first;
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Standard-library-style priority_queue adapter
+    ////////////////////////////////////////////////////////////
+
+    // Container adapter similar to std::priority_queue, except that
+    // it also stores the layout of the underlying poplar heap, which
+    // spares push and pop the O(log n) step needed to figure out the
+    // sizes of the poplars, as well as the position of the bigger
+    // poplar root, which makes top() O(1) and allows pop() to avoid
+    // looking for it
+
+    template<
+        typename T,
+        typename Container = std::vector<T>,
+        typename Compare = std::less<typename Container::value_type>
+    >
+    class priority_queue
+    {
+        public:
+
+            ////////////////////////////////////////////////////////////
+            // Member types
+
+            using container_type = Container;
+            using value_compare = Compare;
+            using value_type = typename Container::value_type;
+            using size_type = typename Container::size_type;
+            using reference = typename Container::reference;
+            using const_reference = typename Container::const_reference;
+
+            ////////////////////////////////////////////////////////////
+            // Construction
+
+            priority_queue():
+                priority_queue(Compare(), Container())
+            {}
+
+            explicit priority_queue(const Compare& compare):
+                priority_queue(compare, Container())
+            {}
+
+            priority_queue(const Compare& compare, const Container& cont):
+                c(cont),
+                comp(compare)
+            {
+                make_layout();
+            }
+
+            priority_queue(const Compare& compare, Container&& cont):
+                c(std::move(cont)),
+                comp(compare)
+            {
+                make_layout();
+            }
+
+            template<typename InputIterator>
+            priority_queue(InputIterator first, InputIterator last,
+                           const Compare& compare=Compare(), Container&& cont=Container()):
+                c(std::move(cont)),
+                comp(compare)
+            {
+                c.insert(c.end(), first, last);
+                make_layout();
+            }
+
+            ////////////////////////////////////////////////////////////
+            // Element access
+
+            auto top() const
+                -> const_reference
+            {
+                return *std::next(c.begin(), difference_type(tracker.max_root));
+            }
+
+            ////////////////////////////////////////////////////////////
+            // Capacity
+
+            auto empty() const
+                -> bool
+            {
+                return c.empty();
+            }
+
+            auto size() const
+                -> size_type
+            {
+                return c.size();
+            }
+
+            ////////////////////////////////////////////////////////////
+            // Modifiers
+
+            auto push(const value_type& value)
+                -> void
+            {
+                c.push_back(value);
+                push_layout();
+            }
+
+            auto push(value_type&& value)
+                -> void
+            {
+                c.push_back(std::move(value));
+                push_layout();
+            }
+
+            template<typename... Args>
+            auto emplace(Args&&... args)
+                -> void
+            {
+                c.emplace_back(std::forward<Args>(args)...);
+                push_layout();
+            }
+
+            auto pop()
+                -> void
+            {
+                detail::pop_bigger_root(c.end(), std::next(c.begin(), difference_type(tracker.max_root)),
+                                        tracker.max_root_size, comp, default_sift);
+                c.pop_back();
+                tracker.pop_back(c.begin(), c.size(), comp);
+            }
+
+            // Same as pop, except that the removed element is moved out
+            // of the queue and returned, which works for move-only types
+            auto pop_value()
+                -> value_type
+            {
+                detail::pop_bigger_root(c.end(), std::next(c.begin(), difference_type(tracker.max_root)),
+                                        tracker.max_root_size, comp, default_sift);
+                value_type res = std::move(c.back());
+                c.pop_back();
+                tracker.pop_back(c.begin(), c.size(), comp);
+                return res;
+            }
+
+            auto swap(priority_queue& other)
+                -> void
+            {
+                using std::swap;
+                swap(c, other.c);
+                swap(comp, other.comp);
+                swap(tracker, other.tracker);
+            }
+
+        protected:
+
+            Container c;
+            Compare comp;
+
+        private:
+
+            using layout_size_t = std::make_unsigned_t<
+                typename std::iterator_traits<typename Container::iterator>::difference_type
+            >;
+
+            using difference_type = typename std::iterator_traits<
+                typename Container::iterator
+            >::difference_type;
+
+            auto make_layout()
+                -> void
+            {
+                poplar::make_heap(c.begin(), c.end(), comp);
+                tracker.reset(c.begin(), c.size(), comp);
+            }
+
+            auto push_layout()
+                -> void
+            {
+                auto poplar_size = tracker.push_back();
+                detail::sift(std::prev(c.end(), poplar_size), poplar_size, comp, default_sift);
+                tracker.pushed(c.begin(), c.size() - 1, poplar_size, comp);
+            }
+
+            detail::heap_tracker<layout_size_t> tracker;
+    };
+
+    template<typename T, typename Container, typename Compare>
+    auto swap(priority_queue<T, Container, Compare>& lhs,
+              priority_queue<T, Container, Compare>& rhs)
+        -> void
+    {
+        lhs.swap(rhs);
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Fixed-capacity priority queue
+    ////////////////////////////////////////////////////////////
+
+    namespace detail
+    {
+        // Smallest unsigned integer type able to represent N
+        template<std::size_t N>
+        using static_size_t = std::conditional_t<
+            N <= std::numeric_limits<std::uint8_t>::max(),
+            std::uint8_t,
+            std::conditional_t<
+                N <= std::numeric_limits<std::uint16_t>::max(),
+                std::uint16_t,
+                std::conditional_t<
+                    N <= std::numeric_limits<std::uint32_t>::max(),
+                    std::uint32_t,
+                    std::size_t
+                >
+            >
+        >;
+    }
+
+    // Priority queue holding at most N elements in a std::array; it
+    // never allocates, tracks the poplar layout and the bigger root
+    // with the smallest integer type able to represent N, and can be
+    // used in constant expressions when the algorithms are constexpr
+
+    template<
+        typename T,
+        std::size_t N,
+        typename Compare = std::less<T>
+    >
+    class static_heap
+    {
+        public:
+
+            ////////////////////////////////////////////////////////////
+            // Member types
+
+            using value_compare = Compare;
+            using value_type = T;
+            using size_type = std::size_t;
+            using reference = T&;
+            using const_reference = const T&;
+            using const_iterator = typename std::array<T, N>::const_iterator;
+
+            ////////////////////////////////////////////////////////////
+            // Construction
+
+            POPLAR_CONSTEXPR static_heap():
+                static_heap(Compare())
+            {}
+
+            explicit POPLAR_CONSTEXPR static_heap(const Compare& compare):
+                comp(compare)
+            {}
+
+            // There shall be at most N elements in [first, last)
+            template<typename InputIterator>
+            POPLAR_CONSTEXPR static_heap(InputIterator first, InputIterator last,
+                                         const Compare& compare=Compare()):
+                comp(compare)
+            {
+                for (; first != last ; ++first) {
+                    c[heap_size] = *first;
+                    ++heap_size;
+                }
+                poplar::make_heap(c.begin(), c.begin() + heap_size, comp);
+                tracker.reset(c.begin(), heap_size, comp);
+            }
+
+            ////////////////////////////////////////////////////////////
+            // Element access
+
+            POPLAR_CONSTEXPR auto top() const
+                -> const_reference
+            {
+                return c[tracker.max_root];
+            }
+
+            // Iterators over the underlying poplar heap
+            POPLAR_CONSTEXPR auto begin() const
+                -> const_iterator
+            {
+                return c.begin();
+            }
+
+            POPLAR_CONSTEXPR auto end() const
+                -> const_iterator
+            {
+                return c.begin() + heap_size;
+            }
+
+            ////////////////////////////////////////////////////////////
+            // Capacity
+
+            POPLAR_CONSTEXPR auto empty() const
+                -> bool
+            {
+                return heap_size == 0;
+            }
+
+            POPLAR_CONSTEXPR auto size() const
+                -> size_type
+            {
+                return heap_size;
+            }
+
+            static constexpr auto capacity()
+                -> size_type
+            {
+                return N;
+            }
+
+            ////////////////////////////////////////////////////////////
+            // Modifiers
+
+            // The functions adding elements require size() < capacity()
+
+            POPLAR_CONSTEXPR auto push(const value_type& value)
+                -> void
+            {
+                c[heap_size] = value;
+                push_layout();
+            }
+
+            POPLAR_CONSTEXPR auto push(value_type&& value)
+                -> void
+            {
+                c[heap_size] = std::move(value);
+                push_layout();
+            }
+
+            template<typename... Args>
+            POPLAR_CONSTEXPR auto emplace(Args&&... args)
+                -> void
+            {
+                c[heap_size] = value_type(std::forward<Args>(args)...);
+                push_layout();
+            }
+
+            // The removed element is left in a moved-from state past
+            // the end of the heap instead of being destroyed
+            POPLAR_CONSTEXPR auto pop()
+                -> void
+            {
+                detail::pop_bigger_root(c.begin() + heap_size, c.begin() + tracker.max_root,
+                                        tracker.max_root_size, comp, default_sift);
+                --heap_size;
+                tracker.pop_back(c.begin(), heap_size, comp);
+            }
+
+            POPLAR_CONSTEXPR auto swap(static_heap& other)
+                -> void
+            {
+                using std::swap;
+                swap(c, other.c);
+                swap(comp, other.comp);
+                swap(heap_size, other.heap_size);
+                swap(tracker, other.tracker);
+            }
+
+        protected:
+
+            std::array<T, N> c = {};
+            Compare comp;
+
+        private:
+
+            using layout_size_t = detail::static_size_t<N>;
+
+            POPLAR_CONSTEXPR auto push_layout()
+                -> void
+            {
+                ++heap_size;
+                auto poplar_size = tracker.push_back();
+                detail::sift(c.begin() + (heap_size - poplar_size), poplar_size, comp, default_sift);
+                tracker.pushed(c.begin(), layout_size_t(heap_size - 1), poplar_size, comp);
+            }
+
+            layout_size_t heap_size = 0;
+            detail::heap_tracker<layout_size_t> tracker;
+    };
+
+    template<typename T, std::size_t N, typename Compare>
+    POPLAR_CONSTEXPR auto swap(static_heap<T, N, Compare>& lhs,
+                               static_heap<T, N, Compare>& rhs)
+        -> void
+    {
+        lhs.swap(rhs);
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Streaming make_heap
+    ////////////////////////////////////////////////////////////
+
+    // Builds a poplar heap out of elements appended chunk by chunk: the
+    // elements are organized the same way make_heap would do it as soon
+    // as enough of them are available, so that only the last few ones
+    // are left to be handled when finish() is called. The builder keeps
+    // the layout of what is already a poplar heap and the number of
+    // elements appended after it, which are not part of the heap yet
+
+    template<
+        typename T,
+        typename Container = std::vector<T>,
+        typename Compare = std::less<typename Container::value_type>
+    >
+    class heap_builder
+    {
+        public:
+
+            ////////////////////////////////////////////////////////////
+            // Member types
+
+            using container_type = Container;
+            using value_compare = Compare;
+            using value_type = typename Container::value_type;
+            using size_type = typename Container::size_type;
+
+            ////////////////////////////////////////////////////////////
+            // Construction
+
+            heap_builder():
+                heap_builder(Compare())
+            {}
+
+            explicit heap_builder(const Compare& compare):
+                c(),
+                comp(compare)
+            {}
+
+            ////////////////////////////////////////////////////////////
+            // Capacity
+
+            auto empty() const
+                -> bool
+            {
+                return c.empty();
+            }
+
+            auto size() const
+                -> size_type
+            {
+                return c.size();
+            }
+
+            ////////////////////////////////////////////////////////////
+            // Modifiers
+
+            template<typename InputIterator>
+            auto append(InputIterator first, InputIterator last)
+                -> void
+            {
+                c.insert(c.end(), first, last);
+                build();
+            }
+
+            auto push_back(const value_type& value)
+                -> void
+            {
+                c.push_back(value);
+                build();
+            }
+
+            auto push_back(value_type&& value)
+                -> void
+            {
+                c.push_back(std::move(value));
+                build();
+            }
+
+            // Turns the remaining elements into poplars and returns
+            // the resulting poplar heap, leaving the builder empty
+            auto finish()
+                -> Container
+            {
+                // Fuse the last poplars if needed, then the remaining
+                // elements are fewer than the smallest poplar and can
+                // be sorted to make poplars, like at the end of make_heap
+                while (layout.doubled && heap_size != c.size()) {
+                    push_one();
+                }
+                detail::insertion_sort(std::next(c.begin(), heap_size), c.end(), comp);
+
+                Container res = std::move(c);
+                c.clear();
+                layout = {};
+                heap_size = 0;
+                return res;
+            }
+
+            auto swap(heap_builder& other)
+                -> void
+            {
+                using std::swap;
+                swap(c, other.c);
+                swap(comp, other.comp);
+                swap(layout, other.layout);
+                swap(heap_size, other.heap_size);
+            }
+
+        protected:
+
+            Container c;
+            Compare comp;
+
+        private:
+
+            using layout_size_t = std::make_unsigned_t<
+                typename std::iterator_traits<typename Container::iterator>::difference_type
+            >;
+
+            static constexpr std::size_t base_size = poplar::small_poplar_size<value_type>::value;
+            static_assert(base_size != 0 && (base_size & (base_size + 1)) == 0,
+                          "small_poplar_size must be of the form 2^n-1");
+
+            // Same sequence of operations as make_heap: fuse the two
+            // last poplars with the next element when they have the
+            // same size, otherwise make a small poplar out of the next
+            // elements when there are enough of them
+            auto build()
+                -> void
+            {
+                while (true) {
+                    layout_size_t remaining = c.size() - heap_size;
+                    if (layout.doubled) {
+                        if (remaining == 0) return;
+                        push_one();
+                    } else if (remaining >= base_size) {
+                        detail::make_small_poplar<base_size>(std::next(c.begin(), heap_size), comp);
+                        layout.push_back_poplar(base_size);
+                        heap_size += base_size;
+                    } else {
+                        return;
+                    }
+                }
+            }
+
+            auto push_one()
+                -> void
+            {
+                auto poplar_size = layout.push_back();
+                ++heap_size;
+                auto last = std::next(c.begin(), heap_size);
+                detail::sift(std::prev(last, poplar_size), poplar_size, comp, default_sift);
+            }
+
+            detail::poplar_layout<layout_size_t> layout;
+            // Number of elements that are already part of the poplar heap
+            layout_size_t heap_size = 0;
+    };
+
+    template<typename T, typename Container, typename Compare>
+    auto swap(heap_builder<T, Container, Compare>& lhs,
+              heap_builder<T, Container, Compare>& rhs)
+        -> void
+    {
+        lhs.swap(rhs);
+    }
 }
 
 #endif // POPLAR_HEAP_H_
@@ -0,0 +1,434 @@
+/*
+ * The MIT No Attribution License (MIT-0)
+ *
+ * Copyright (c) 2017-2020 Morwenn
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef POPLAR_EXTERNAL_SORT_H_
+#define POPLAR_EXTERNAL_SORT_H_
+
+////////////////////////////////////////////////////////////
+// Headers
+////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "poplar.h"
+
+namespace poplar
+{
+    namespace detail
+    {
+        ////////////////////////////////////////////////////////////
+        // Temporary storage for the sorted runs
+        ////////////////////////////////////////////////////////////
+
+        // Anonymous file created with std::tmpfile, deleted when it
+        // is closed; the elements are stored as raw bytes, and all the
+        // runs of a merge pass share the same file so that the number
+        // of open files doesn't grow with the number of runs
+        class temporary_file
+        {
+            public:
+
+                temporary_file():
+                    file(std::tmpfile())
+                {
+                    if (file == nullptr) {
+                        throw std::system_error(errno, std::generic_category(),
+                                                "poplar::external_sort: can't create a temporary file");
+                    }
+                }
+
+                temporary_file(temporary_file&& other) noexcept:
+                    file(other.file)
+                {
+                    other.file = nullptr;
+                }
+
+                temporary_file& operator=(temporary_file&& other) noexcept
+                {
+                    std::swap(file, other.file);
+                    return *this;
+                }
+
+                ~temporary_file()
+                {
+                    if (file != nullptr) {
+                        std::fclose(file);
+                    }
+                }
+
+                // Position of the next write; std::fpos_t is used instead
+                // of an offset since long is not always large enough
+                auto position()
+                    -> std::fpos_t
+                {
+                    std::fpos_t res;
+                    if (std::fgetpos(file, &res) != 0) {
+                        throw std::system_error(errno, std::generic_category(),
+                                                "poplar::external_sort: can't seek a temporary file");
+                    }
+                    return res;
+                }
+
+                // Writes are only ever appended to the end of the file
+                template<typename T>
+                auto write(const T* data, std::size_t count)
+                    -> void
+                {
+                    if (std::fwrite(data, sizeof(T), count, file) != count) {
+                        throw std::system_error(errno, std::generic_category(),
+                                                "poplar::external_sort: can't write a temporary file");
+                    }
+                }
+
+                // Reads count elements starting at pos and moves pos past
+                // them, returns the number of elements read
+                template<typename T>
+                auto read(T* data, std::size_t count, std::fpos_t& pos)
+                    -> std::size_t
+                {
+                    if (std::fsetpos(file, &pos) != 0) {
+                        throw std::system_error(errno, std::generic_category(),
+                                                "poplar::external_sort: can't seek a temporary file");
+                    }
+                    auto res = std::fread(data, sizeof(T), count, file);
+                    if (res != count && std::ferror(file)) {
+                        throw std::system_error(errno, std::generic_category(),
+                                                "poplar::external_sort: can't read a temporary file");
+                    }
+                    pos = position();
+                    return res;
+                }
+
+                // Must be called between the last write and the first read
+                auto flush()
+                    -> void
+                {
+                    if (std::fflush(file) != 0) {
+                        throw std::system_error(errno, std::generic_category(),
+                                                "poplar::external_sort: can't write a temporary file");
+                    }
+                }
+
+            private:
+
+                std::FILE* file;
+        };
+
+        // Uninitialized storage for the elements: they are trivially
+        // copyable, so they are copy-constructed or read as raw bytes
+        // in place and never need to be default constructible
+        template<typename T>
+        class external_buffer
+        {
+            public:
+
+                explicit external_buffer(std::size_t size):
+                    buffer_data(std::allocator<T>{}.allocate(size)),
+                    buffer_size(size)
+                {}
+
+                external_buffer(const external_buffer&) = delete;
+                external_buffer& operator=(const external_buffer&) = delete;
+
+                ~external_buffer()
+                {
+                    std::allocator<T>{}.deallocate(buffer_data, buffer_size);
+                }
+
+                auto data() const noexcept
+                    -> T*
+                {
+                    return buffer_data;
+                }
+
+            private:
+
+                T* buffer_data;
+                std::size_t buffer_size;
+        };
+
+        // Sorted run stored in a temporary file
+        struct external_run
+        {
+            std::fpos_t position;
+            std::size_t size;
+        };
+
+        // Reads a run block by block into its slice of the buffer
+        template<typename T>
+        class run_reader
+        {
+            public:
+
+                run_reader(temporary_file& from, const external_run& run,
+                           T* buffer, std::size_t buffer_size):
+                    file(&from),
+                    position(run.position),
+                    remaining(run.size),
+                    block(buffer),
+                    block_size(buffer_size)
+                {}
+
+                // Moves to the next element of the run, which is read in
+                // place in the block; returns false when the run is
+                // exhausted
+                auto next()
+                    -> bool
+                {
+                    if (++pos >= count) {
+                        if (remaining == 0) return false;
+                        count = file->read(block, (std::min)(block_size, remaining), position);
+                        pos = 0;
+                        if (count == 0) return false;
+                        remaining -= count;
+                    }
+                    return true;
+                }
+
+                // Current element of the run, valid after next returned true
+                auto head() const
+                    -> const T&
+                {
+                    return block[pos];
+                }
+
+            private:
+
+                temporary_file* file;
+                std::fpos_t position;
+                std::size_t remaining;
+                T* block;
+                std::size_t block_size;
+                std::size_t pos = 0;
+                std::size_t count = 0;
+        };
+
+        // Appends a run to a file block by block from its slice of the
+        // buffer
+        template<typename T>
+        class run_writer
+        {
+            public:
+
+                run_writer(temporary_file& to, T* buffer, std::size_t buffer_size):
+                    file(&to),
+                    run{ to.position(), 0 },
+                    block(buffer),
+                    block_size(buffer_size)
+                {}
+
+                auto operator()(const T& value)
+                    -> void
+                {
+                    ::new (static_cast<void*>(block + count)) T(value);
+                    if (++count == block_size) {
+                        flush();
+                    }
+                }
+
+                // Writes what remains in the buffer and returns the run
+                auto finish()
+                    -> external_run
+                {
+                    flush();
+                    return run;
+                }
+
+            private:
+
+                auto flush()
+                    -> void
+                {
+                    file->write(block, count);
+                    run.size += count;
+                    count = 0;
+                }
+
+                temporary_file* file;
+                external_run run;
+                T* block;
+                std::size_t block_size;
+                std::size_t count = 0;
+        };
+
+        template<typename OutputIterator>
+        struct iterator_sink
+        {
+            OutputIterator result;
+
+            template<typename T>
+            auto operator()(const T& value)
+                -> void
+            {
+                *result = value;
+                ++result;
+            }
+        };
+
+        ////////////////////////////////////////////////////////////
+        // External sort helper functions
+        ////////////////////////////////////////////////////////////
+
+        // Smallest number of elements read from or written to a run at
+        // once, merging more runs than the buffer allows with blocks of
+        // that size takes several passes
+        template<typename T>
+        constexpr auto external_block_size() noexcept
+            -> std::size_t
+        {
+            return sizeof(T) >= 4096 ? 1 : 4096 / sizeof(T);
+        }
+
+        // Merges the given runs into sink; the buffer is split into one
+        // block per run plus one block which the sink may use to write
+        // its output. The readers of the runs are kept in a poplar heap
+        // ordered so that the one with the smallest head is at the top,
+        // the heads staying in their blocks so that no element is held
+        // outside of the buffer
+        template<typename T, typename Sink, typename Compare, typename SiftPolicy>
+        auto merge_runs(temporary_file& file, const external_run* runs, std::size_t nb_runs,
+                        T* buffer, std::size_t block_size, Sink& sink,
+                        Compare compare, SiftPolicy policy)
+            -> void
+        {
+            std::vector<run_reader<T>> readers;
+            readers.reserve(nb_runs);
+            std::vector<run_reader<T>*> heads;
+            heads.reserve(nb_runs);
+            for (std::size_t i = 0 ; i < nb_runs ; ++i) {
+                readers.emplace_back(file, runs[i], buffer + i * block_size, block_size);
+                if (readers.back().next()) {
+                    heads.push_back(&readers.back());
+                }
+            }
+
+            auto heads_compare = [&compare](const run_reader<T>* lhs, const run_reader<T>* rhs) {
+                return compare(rhs->head(), lhs->head());
+            };
+
+            using poplar_size_t = std::make_unsigned_t<std::ptrdiff_t>;
+            poplar::make_heap(heads.begin(), heads.end(), heads_compare, policy);
+            while (!heads.empty()) {
+                // Output the smallest head and replace it with the next
+                // element of its run, or remove it if there is none
+                poplar_size_t size = heads.size();
+                auto poplar_size = bit_floor(size + 1u) - 1u;
+                auto top = bigger_root(heads.begin(), heads.end(), size, poplar_size, heads_compare);
+                sink((*top.first)->head());
+                if ((*top.first)->next()) {
+                    sift(top.first - (top.second - 1), top.second, heads_compare, policy);
+                } else {
+                    poplar::erase_heap(heads.begin(), heads.end(), top.first, heads_compare, policy);
+                    heads.pop_back();
+                }
+            }
+        }
+    }
+
+    ////////////////////////////////////////////////////////////
+    // External sort
+    ////////////////////////////////////////////////////////////
+
+    // Sorts the elements of [first, last) into result while holding at
+    // most buffer_size of them in memory: runs of buffer_size elements
+    // are sorted in place with poplar sort, which needs no extra memory,
+    // and appended to a temporary file, then merged with a poplar heap
+
+    template<
+        typename InputIterator,
+        typename OutputIterator,
+        typename Compare = std::less<>,
+        typename SiftPolicy = default_sift_t
+    >
+    auto external_sort(InputIterator first, InputIterator last, OutputIterator result,
+                       std::size_t buffer_size, Compare compare={}, SiftPolicy policy={})
+        -> OutputIterator
+    {
+        using value_type = typename std::iterator_traits<InputIterator>::value_type;
+        static_assert(std::is_trivially_copyable<value_type>::value,
+                      "poplar::external_sort stores the elements as raw bytes "
+                      "and requires them to be trivially copyable");
+
+        // At least one element per block for two runs and the output
+        buffer_size = (std::max)(buffer_size, std::size_t(3));
+        detail::external_buffer<value_type> storage(buffer_size);
+        value_type* buffer = storage.data();
+
+        // Produce the sorted runs
+        detail::temporary_file file;
+        std::vector<detail::external_run> runs;
+        while (true) {
+            std::size_t count = 0;
+            for (; count != buffer_size && first != last ; ++first) {
+                ::new (static_cast<void*>(buffer + count++)) value_type(*first);
+            }
+            poplar::sort(buffer, buffer + count, compare, policy);
+            if (runs.empty() && first == last) {
+                // Everything fit in memory
+                return std::copy(buffer, buffer + count, std::move(result));
+            }
+            if (count != 0) {
+                runs.push_back({ file.position(), count });
+                file.write(buffer, count);
+            }
+            if (first == last) break;
+        }
+
+        // Merge as many runs at once as the buffer allows, with several
+        // passes when they don't all fit: every pass writes the merged
+        // runs to a new file which replaces the previous one
+        file.flush();
+        const std::size_t max_runs = (std::max)(
+            buffer_size / detail::external_block_size<value_type>(), std::size_t(3)
+        ) - 1;
+        while (runs.size() > max_runs) {
+            detail::temporary_file merged_file;
+            std::vector<detail::external_run> merged_runs;
+            for (std::size_t i = 0 ; i < runs.size() ; i += max_runs) {
+                std::size_t nb_runs = (std::min)(max_runs, runs.size() - i);
+                std::size_t block_size = buffer_size / (nb_runs + 1);
+                detail::run_writer<value_type> writer(merged_file, buffer + nb_runs * block_size,
+                                                      block_size);
+                detail::merge_runs(file, runs.data() + i, nb_runs, buffer, block_size,
+                                   writer, compare, policy);
+                merged_runs.push_back(writer.finish());
+            }
+            merged_file.flush();
+            file = std::move(merged_file);
+            runs = std::move(merged_runs);
+        }
+
+        detail::iterator_sink<OutputIterator> sink = { std::move(result) };
+        detail::merge_runs(file, runs.data(), runs.size(), buffer, buffer_size / runs.size(),
+                           sink, std::move(compare), policy);
+        return sink.result;
+    }
+}
+
+#endif // POPLAR_EXTERNAL_SORT_H_
@@ -0,0 +1,438 @@
+/*
+ * The MIT No Attribution License (MIT-0)
+ *
+ * Copyright (c) 2017-2020 Morwenn
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef POPLAR_MAPPED_HEAP_H_
+#define POPLAR_MAPPED_HEAP_H_
+
+////////////////////////////////////////////////////////////
+// Headers
+////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "poplar.h"
+
+namespace poplar
+{
+    namespace detail
+    {
+        ////////////////////////////////////////////////////////////
+        // Memory-mapped heap file layout
+        ////////////////////////////////////////////////////////////
+
+        // Beginning of a mapped heap file, followed by the elements of
+        // the poplar heap. When an operation is in progress dirty is
+        // set, and the other fields describe how to finish it: the
+        // sifted value has to be put where the hole currently is, and
+        // the heap has pending_size elements
+        template<typename T>
+        struct mapped_heap_header
+        {
+            std::uint64_t magic;
+            std::uint64_t value_size;
+            std::uint64_t size;
+            std::uint64_t dirty;
+            std::uint64_t pending_size;
+            std::uint64_t hole;
+            T pending;
+        };
+
+        // "POPLARHP" read as a little-endian integer
+        constexpr std::uint64_t mapped_heap_magic = 0x504852414c504f50u;
+
+        // Keeps the compiler from reordering the writes to the mapped
+        // file across it, so that the journal always describes the
+        // current state of the heap when the process dies
+        inline auto mapped_heap_barrier() noexcept
+            -> void
+        {
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+        }
+
+        [[noreturn]] inline auto throw_mapped_heap_error(const char* message)
+            -> void
+        {
+            throw std::system_error(errno, std::generic_category(), message);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Persistent priority queue
+    ////////////////////////////////////////////////////////////
+
+    // Priority queue whose poplar heap lives in a memory-mapped file:
+    // since a poplar heap doesn't need anything but its elements and
+    // its size, reopening the file gives back the queue immediately.
+    // Every push and pop is journaled in the header of the file, so
+    // that reopening it after the process died in the middle of one
+    // of them completes the operation and sifts the element it left
+    // in the hole to repair the heap
+
+    template<
+        typename T,
+        typename Compare = std::less<T>
+    >
+    class mapped_heap
+    {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "poplar::mapped_heap stores the elements as raw bytes "
+                      "and requires them to be trivially copyable");
+
+        public:
+
+            ////////////////////////////////////////////////////////////
+            // Member types
+
+            using value_compare = Compare;
+            using value_type = T;
+            using size_type = std::size_t;
+            using const_reference = const T&;
+
+            ////////////////////////////////////////////////////////////
+            // Construction
+
+            // Opens the heap stored in the file at path, or creates an
+            // empty one if the file doesn't exist or is empty
+            explicit mapped_heap(const char* path, const Compare& compare=Compare()):
+                comp(compare)
+            {
+                fd = ::open(path, O_RDWR | O_CREAT, 0644);
+                if (fd == -1) {
+                    detail::throw_mapped_heap_error("poplar::mapped_heap: can't open the file");
+                }
+
+                struct ::stat file_stat;
+                if (::fstat(fd, &file_stat) == -1) {
+                    close_file();
+                    detail::throw_mapped_heap_error("poplar::mapped_heap: can't stat the file");
+                }
+
+                try {
+                    if (file_stat.st_size == 0) {
+                        resize_file(initial_capacity);
+                        map(initial_capacity);
+                        header->magic = detail::mapped_heap_magic;
+                        header->value_size = sizeof(T);
+                        header->size = 0;
+                        header->dirty = 0;
+                    } else {
+                        auto bytes = static_cast<std::size_t>(file_stat.st_size);
+                        if (bytes < sizeof(header_type) ||
+                            (bytes - sizeof(header_type)) % sizeof(T) != 0) {
+                            throw std::runtime_error("poplar::mapped_heap: not a heap file");
+                        }
+                        // Mapped at its current size so that a file which
+                        // turns out not to be a heap is left untouched
+                        map((bytes - sizeof(header_type)) / sizeof(T));
+                        if (header->magic != detail::mapped_heap_magic ||
+                            header->value_size != sizeof(T) ||
+                            header->size > heap_capacity) {
+                            throw std::runtime_error("poplar::mapped_heap: not a heap file");
+                        }
+                        if (header->dirty != 0) {
+                            recover();
+                        }
+                    }
+                } catch (...) {
+                    unmap();
+                    close_file();
+                    throw;
+                }
+
+                tracker.reset(data, header->size, comp);
+            }
+
+            // A moved-from mapped_heap doesn't own a file anymore: it
+            // can only be destroyed or assigned to
+            mapped_heap(mapped_heap&& other) noexcept:
+                comp(std::move(other.comp)),
+                fd(other.fd),
+                header(other.header),
+                data(other.data),
+                heap_capacity(other.heap_capacity),
+                tracker(other.tracker)
+            {
+                other.fd = -1;
+                other.header = nullptr;
+            }
+
+            mapped_heap& operator=(mapped_heap&& other) noexcept
+            {
+                swap(other);
+                return *this;
+            }
+
+            ~mapped_heap()
+            {
+                unmap();
+                close_file();
+            }
+
+            ////////////////////////////////////////////////////////////
+            // Element access
+
+            auto top() const
+                -> const_reference
+            {
+                return data[tracker.max_root];
+            }
+
+            ////////////////////////////////////////////////////////////
+            // Capacity
+
+            auto empty() const
+                -> bool
+            {
+                return header->size == 0;
+            }
+
+            auto size() const
+                -> size_type
+            {
+                return header->size;
+            }
+
+            auto capacity() const
+                -> size_type
+            {
+                return heap_capacity;
+            }
+
+            // Grows the file so that it can hold at least new_capacity
+            // elements, which invalidates references to the elements;
+            // the heap is left unchanged and usable if it throws
+            auto reserve(size_type new_capacity)
+                -> void
+            {
+                if (new_capacity <= heap_capacity) return;
+                // Growing the file doesn't invalidate the old mapping,
+                // which is only released once the new one exists
+                resize_file(new_capacity);
+                auto old_header = header;
+                auto old_capacity = heap_capacity;
+                map(new_capacity);
+                ::munmap(old_header, file_size(old_capacity));
+            }
+
+            ////////////////////////////////////////////////////////////
+            // Modifiers
+
+            auto push(const value_type& value)
+                -> void
+            {
+                size_type size = header->size;
+                if (size == heap_capacity) {
+                    // A file holding only a header has no capacity
+                    reserve((std::max)(2 * heap_capacity, size_type(initial_capacity)));
+                }
+
+                // The new element is the root of the last poplar, and
+                // it is sifted down from the end of the heap
+                auto poplar_size = tracker.push_back();
+                start_operation(value, size, size + 1);
+                sift(size, poplar_size);
+                tracker.pushed(data, size, poplar_size, comp);
+            }
+
+            auto pop()
+                -> void
+            {
+                size_type last_root = header->size - 1;
+                if (tracker.max_root == last_root) {
+                    header->size = last_root;
+                } else {
+                    // Move the last element where the bigger root was
+                    // and sift it down its new poplar
+                    start_operation(data[last_root], tracker.max_root, last_root);
+                    sift(tracker.max_root, tracker.max_root_size);
+                }
+                tracker.pop_back(data, header->size, comp);
+            }
+
+            // Writes the file back to the disk, which is only needed to
+            // survive a crash of the system rather than of the process
+            auto sync()
+                -> void
+            {
+                if (::msync(header, file_size(heap_capacity), MS_SYNC) == -1) {
+                    detail::throw_mapped_heap_error("poplar::mapped_heap: can't sync the file");
+                }
+            }
+
+            auto swap(mapped_heap& other) noexcept
+                -> void
+            {
+                using std::swap;
+                swap(comp, other.comp);
+                swap(fd, other.fd);
+                swap(header, other.header);
+                swap(data, other.data);
+                swap(heap_capacity, other.heap_capacity);
+                swap(tracker, other.tracker);
+            }
+
+        protected:
+
+            Compare comp;
+
+        private:
+
+            using header_type = detail::mapped_heap_header<T>;
+
+            static constexpr size_type initial_capacity = 64;
+
+            static constexpr auto file_size(size_type capacity)
+                -> size_type
+            {
+                return sizeof(header_type) + capacity * sizeof(T);
+            }
+
+            auto resize_file(size_type capacity)
+                -> void
+            {
+                if (::ftruncate(fd, static_cast<::off_t>(file_size(capacity))) == -1) {
+                    detail::throw_mapped_heap_error("poplar::mapped_heap: can't resize the file");
+                }
+            }
+
+            // Maps the first file_size(capacity) bytes of the file, the
+            // current mapping is left alone if it fails
+            auto map(size_type capacity)
+                -> void
+            {
+                void* address = ::mmap(nullptr, file_size(capacity), PROT_READ | PROT_WRITE,
+                                       MAP_SHARED, fd, 0);
+                if (address == MAP_FAILED) {
+                    detail::throw_mapped_heap_error("poplar::mapped_heap: can't map the file");
+                }
+                header = static_cast<header_type*>(address);
+                data = reinterpret_cast<T*>(header + 1);
+                heap_capacity = capacity;
+            }
+
+            auto unmap() noexcept
+                -> void
+            {
+                if (header != nullptr) {
+                    ::munmap(header, file_size(heap_capacity));
+                    header = nullptr;
+                }
+            }
+
+            auto close_file() noexcept
+                -> void
+            {
+                if (fd != -1) {
+                    ::close(fd);
+                    fd = -1;
+                }
+            }
+
+            // Journals an operation that sifts value down from hole and
+            // leaves the heap with new_size elements
+            auto start_operation(const value_type& value, size_type hole, size_type new_size)
+                -> void
+            {
+                header->pending = value;
+                header->hole = hole;
+                header->pending_size = new_size;
+                detail::mapped_heap_barrier();
+                header->dirty = 1;
+                detail::mapped_heap_barrier();
+            }
+
+            // Same algorithm as hole_sift, except that the position of
+            // the hole is journaled every time it moves, and that the
+            // sifted value lives in the journal
+            auto sift(size_type root, size_type size)
+                -> void
+            {
+                const value_type& value = header->pending;
+                while (size >= 3) {
+                    auto child_root1 = root - 1;
+                    auto child_root2 = root - (size - size / 2);
+                    auto max_child = comp(data[child_root1], data[child_root2]) ? child_root2
+                                                                                : child_root1;
+                    if (!comp(value, data[max_child])) break;
+
+                    data[root] = data[max_child];
+                    detail::mapped_heap_barrier();
+                    header->hole = max_child;
+                    detail::mapped_heap_barrier();
+                    root = max_child;
+                    size /= 2;
+                }
+                finish_operation(root);
+            }
+
+            auto finish_operation(size_type hole)
+                -> void
+            {
+                data[hole] = header->pending;
+                detail::mapped_heap_barrier();
+                header->size = header->pending_size;
+                detail::mapped_heap_barrier();
+                header->dirty = 0;
+            }
+
+            // Completes an operation interrupted by the death of the
+            // process: every element but the sifted one is somewhere in
+            // the heap, and the hole holds a copy of one of them. The
+            // elements moved up from the path of the hole all compared
+            // greater than the sifted one, so putting it back in the
+            // hole can only break the heap below it
+            auto recover()
+                -> void
+            {
+                if (header->pending_size > heap_capacity || header->hole >= header->pending_size) {
+                    throw std::runtime_error("poplar::mapped_heap: corrupted journal");
+                }
+                auto hole = header->hole;
+                finish_operation(hole);
+                poplar::update_heap(data, data + header->size, data + hole, comp);
+            }
+
+            int fd = -1;
+            header_type* header = nullptr;
+            T* data = nullptr;
+            size_type heap_capacity = 0;
+            detail::heap_tracker<size_type> tracker;
+    };
+
+    template<typename T, typename Compare>
+    auto swap(mapped_heap<T, Compare>& lhs, mapped_heap<T, Compare>& rhs) noexcept
+        -> void
+    {
+        lhs.swap(rhs);
+    }
+}
+
+#endif // POPLAR_MAPPED_HEAP_H_
@@ -0,0 +1,379 @@
+/*
+ * The MIT No Attribution License (MIT-0)
+ *
+ * Copyright (c) 2017-2020 Morwenn
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef POPLAR_MINMAX_H_
+#define POPLAR_MINMAX_H_
+
+////////////////////////////////////////////////////////////
+// Headers
+////////////////////////////////////////////////////////////
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include "poplar.h"
+
+namespace poplar
+{
+    namespace detail
+    {
+        ////////////////////////////////////////////////////////////
+        // Min-max poplar heap specific helper functions
+        ////////////////////////////////////////////////////////////
+
+        // A min-max poplar heap is a poplar heap of nodes made of two
+        // consecutive elements, lo then hi with !compare(hi, lo), where
+        // the interval of every node contains the intervals of its
+        // children: the hi elements form a max poplar heap and the lo
+        // elements a min poplar heap. When the number of elements is
+        // odd, the last one doesn't belong to any node. All the sizes
+        // below are numbers of nodes
+
+        template<typename RandomAccessIterator>
+        using minmax_size_t = std::make_unsigned_t<
+            typename std::iterator_traits<RandomAccessIterator>::difference_type
+        >;
+
+        // Sifts the hi element of the root of a poplar of nodes down the
+        // hi elements; when it ends up below the lo element of a node,
+        // they are exchanged and the former lo element is sifted instead
+        template<typename RandomAccessIterator, typename Size, typename Compare>
+        auto minmax_sift_max(RandomAccessIterator first, Size size, Compare compare)
+            -> void
+        {
+            using std::iter_swap;
+            sift_recorder recorder;
+
+            auto root = first + 2 * (size - 1);
+            if (compare(root[1], root[0])) {
+                iter_swap(root, root + 1);
+                record_swaps(1);
+            }
+            while (size >= 3) {
+                auto child_root1 = root - 2;
+                auto child_root2 = root - 2 * (size - size / 2);
+                auto max_root = compare(child_root1[1], child_root2[1]) ? child_root2 : child_root1;
+                if (!compare(root[1], max_root[1])) return;
+
+                iter_swap(root + 1, max_root + 1);
+                record_swaps(1);
+                recorder.level();
+                root = max_root;
+                size /= 2;
+                if (compare(root[1], root[0])) {
+                    iter_swap(root, root + 1);
+                    record_swaps(1);
+                }
+            }
+        }
+
+        // Same as above for the lo element of the root
+        template<typename RandomAccessIterator, typename Size, typename Compare>
+        auto minmax_sift_min(RandomAccessIterator first, Size size, Compare compare)
+            -> void
+        {
+            using std::iter_swap;
+            sift_recorder recorder;
+
+            auto root = first + 2 * (size - 1);
+            if (compare(root[1], root[0])) {
+                iter_swap(root, root + 1);
+                record_swaps(1);
+            }
+            while (size >= 3) {
+                auto child_root1 = root - 2;
+                auto child_root2 = root - 2 * (size - size / 2);
+                auto min_root = compare(child_root2[0], child_root1[0]) ? child_root2 : child_root1;
+                if (!compare(min_root[0], root[0])) return;
+
+                iter_swap(root, min_root);
+                record_swaps(1);
+                recorder.level();
+                root = min_root;
+                size /= 2;
+                if (compare(root[1], root[0])) {
+                    iter_swap(root, root + 1);
+                    record_swaps(1);
+                }
+            }
+        }
+
+        // Fixes a poplar whose subpoplars are valid but whose root
+        // is not: the hi element is sifted first, after which the lo
+        // element is the only one that can still be misplaced
+        template<typename RandomAccessIterator, typename Size, typename Compare>
+        auto minmax_sift(RandomAccessIterator first, Size size, Compare compare)
+            -> void
+        {
+            minmax_sift_max(first, size, compare);
+            minmax_sift_min(std::move(first), size, std::move(compare));
+        }
+
+        template<typename RandomAccessIterator, typename Size, typename Compare>
+        auto make_minmax_poplar(RandomAccessIterator first, Size size, Compare compare)
+            -> void
+        {
+            if (size >= 3) {
+                make_minmax_poplar(first, size / 2, compare);
+                make_minmax_poplar(first + 2 * (size / 2), size / 2, compare);
+            }
+            minmax_sift(std::move(first), size, std::move(compare));
+        }
+
+        // Finds the poplar root whose element at the given offset in the
+        // node (0 for lo, 1 for hi) is the highest with respect to compare,
+        // returns the root and the size of the corresponding poplar
+        template<typename RandomAccessIterator, typename Size, typename Compare>
+        auto minmax_bigger_root(RandomAccessIterator first, Size nb_nodes,
+                                std::size_t offset, Compare compare)
+            -> std::pair<RandomAccessIterator, Size>
+        {
+            Size poplar_size = bit_floor(nb_nodes + 1u) - 1u;
+            auto bigger = first + 2 * (poplar_size - 1);
+            auto bigger_size = poplar_size;
+
+            auto it = bigger + 2;
+            nb_nodes -= poplar_size;
+            while (nb_nodes != 0) {
+                poplar_size = unguarded_bit_floor(nb_nodes + 1u) - 1u;
+                auto root = it + 2 * (poplar_size - 1);
+                if (compare(bigger[offset], root[offset])) {
+                    bigger = root;
+                    bigger_size = poplar_size;
+                }
+                it = root + 2;
+                nb_nodes -= poplar_size;
+            }
+            return { bigger, bigger_size };
+        }
+
+        template<typename RandomAccessIterator, typename Size, typename Compare>
+        auto is_minmax_poplar(RandomAccessIterator first, Size size, Compare& compare)
+            -> bool
+        {
+            auto root = first + 2 * (size - 1);
+            if (compare(root[1], root[0])) return false;
+            if (size < 3) return true;
+
+            auto child_root1 = root - 2;
+            auto child_root2 = root - 2 * (size - size / 2);
+            return !compare(root[1], child_root1[1]) && !compare(child_root1[0], root[0])
+                && !compare(root[1], child_root2[1]) && !compare(child_root2[0], root[0])
+                && is_minmax_poplar(first, size / 2, compare)
+                && is_minmax_poplar(first + 2 * (size / 2), size / 2, compare);
+        }
+
+        // Compares the lo elements of the nodes as if they were the
+        // hi elements of a max heap
+        template<typename Compare>
+        struct minmax_reverse_compare
+        {
+            Compare& compare;
+
+            template<typename T, typename U>
+            auto operator()(T&& lhs, U&& rhs)
+                -> bool
+            {
+                return compare(std::forward<U>(rhs), std::forward<T>(lhs));
+            }
+        };
+    }
+
+    namespace minmax
+    {
+        ////////////////////////////////////////////////////////////
+        // Min-max poplar heap algorithms
+        ////////////////////////////////////////////////////////////
+
+        template<
+            typename RandomAccessIterator,
+            typename Compare = std::less<>
+        >
+        auto make_heap(RandomAccessIterator first, RandomAccessIterator last,
+                       Compare compare={})
+            -> void
+        {
+            detail::minmax_size_t<RandomAccessIterator> nb_nodes = std::distance(first, last) / 2;
+            while (nb_nodes != 0) {
+                auto poplar_size = detail::bit_floor(nb_nodes + 1u) - 1u;
+                detail::make_minmax_poplar(first, poplar_size, compare);
+                first += 2 * poplar_size;
+                nb_nodes -= poplar_size;
+            }
+        }
+
+        template<
+            typename RandomAccessIterator,
+            typename Compare = std::less<>
+        >
+        auto push_heap(RandomAccessIterator first, RandomAccessIterator last,
+                       Compare compare={})
+            -> void
+        {
+            // With an odd number of elements the new one waits for
+            // another one to make a node
+            auto size = std::distance(first, last);
+            if (size % 2 != 0) return;
+
+            // Otherwise it makes a new node with the element before it,
+            // which is the root of the last poplar
+            detail::minmax_size_t<RandomAccessIterator> nb_nodes = size / 2;
+            auto poplar_size = detail::bit_floor(nb_nodes + 1u) - 1u;
+            while (nb_nodes != poplar_size) {
+                nb_nodes -= poplar_size;
+                poplar_size = detail::unguarded_bit_floor(nb_nodes + 1u) - 1u;
+            }
+            detail::minmax_sift(last - 2 * poplar_size, poplar_size, std::move(compare));
+        }
+
+        // Moves the highest element to last - 1 and makes [first, last - 1)
+        // a min-max poplar heap
+        template<
+            typename RandomAccessIterator,
+            typename Compare = std::less<>
+        >
+        auto pop_max(RandomAccessIterator first, RandomAccessIterator last,
+                     Compare compare={})
+            -> void
+        {
+            using std::iter_swap;
+            auto size = std::distance(first, last);
+            if (size < 2) return;
+
+            detail::minmax_size_t<RandomAccessIterator> nb_nodes = size / 2;
+            auto bigger = detail::minmax_bigger_root(first, nb_nodes, 1, compare);
+            auto last_element = std::prev(last);
+            if (size % 2 != 0) {
+                // The element without a node can be the highest one,
+                // otherwise it replaces the highest one
+                if (!compare(*last_element, bigger.first[1])) return;
+                iter_swap(bigger.first + 1, last_element);
+            } else {
+                // The lo element of the last node loses its node, and
+                // its hi element replaces the highest one if needed
+                if (bigger.first + 1 == last_element) return;
+                iter_swap(bigger.first + 1, last_element);
+            }
+            detail::record_swaps(1);
+            detail::minmax_sift_max(bigger.first - 2 * (bigger.second - 1), bigger.second,
+                                    std::move(compare));
+        }
+
+        // Moves the lowest element to last - 1 and makes [first, last - 1)
+        // a min-max poplar heap
+        template<
+            typename RandomAccessIterator,
+            typename Compare = std::less<>
+        >
+        auto pop_min(RandomAccessIterator first, RandomAccessIterator last,
+                     Compare compare={})
+            -> void
+        {
+            using std::iter_swap;
+            auto size = std::distance(first, last);
+            if (size < 2) return;
+
+            detail::minmax_size_t<RandomAccessIterator> nb_nodes = size / 2;
+            auto smaller = detail::minmax_bigger_root(
+                first, nb_nodes, 0, detail::minmax_reverse_compare<Compare>{compare}
+            );
+            auto last_element = std::prev(last);
+            if (size % 2 != 0) {
+                if (!compare(smaller.first[0], *last_element)) return;
+            } else if (smaller.first + 1 == last_element) {
+                // The lowest element is the lo element of the last node,
+                // which leaves its hi element without a node
+                iter_swap(smaller.first, last_element);
+                detail::record_swaps(1);
+                return;
+            }
+            iter_swap(smaller.first, last_element);
+            detail::record_swaps(1);
+            detail::minmax_sift_min(smaller.first - 2 * (smaller.second - 1), smaller.second,
+                                    std::move(compare));
+        }
+
+        template<
+            typename RandomAccessIterator,
+            typename Compare = std::less<>
+        >
+        auto heap_max(RandomAccessIterator first, RandomAccessIterator last,
+                      Compare compare={})
+            -> RandomAccessIterator
+        {
+            auto size = std::distance(first, last);
+            if (size < 2) return first;
+
+            auto bigger = detail::minmax_bigger_root(
+                first, detail::minmax_size_t<RandomAccessIterator>(size / 2), 1, compare
+            ).first + 1;
+            auto last_element = std::prev(last);
+            if (size % 2 != 0 && compare(*bigger, *last_element)) {
+                return last_element;
+            }
+            return bigger;
+        }
+
+        template<
+            typename RandomAccessIterator,
+            typename Compare = std::less<>
+        >
+        auto heap_min(RandomAccessIterator first, RandomAccessIterator last,
+                      Compare compare={})
+            -> RandomAccessIterator
+        {
+            auto size = std::distance(first, last);
+            if (size < 2) return first;
+
+            auto smaller = detail::minmax_bigger_root(
+                first, detail::minmax_size_t<RandomAccessIterator>(size / 2),
+                0, detail::minmax_reverse_compare<Compare>{compare}
+            ).first;
+            auto last_element = std::prev(last);
+            if (size % 2 != 0 && compare(*last_element, *smaller)) {
+                return last_element;
+            }
+            return smaller;
+        }
+
+        template<
+            typename RandomAccessIterator,
+            typename Compare = std::less<>
+        >
+        auto is_heap(RandomAccessIterator first, RandomAccessIterator last,
+                     Compare compare={})
+            -> bool
+        {
+            detail::minmax_size_t<RandomAccessIterator> nb_nodes = std::distance(first, last) / 2;
+            while (nb_nodes != 0) {
+                auto poplar_size = detail::bit_floor(nb_nodes + 1u) - 1u;
+                if (!detail::is_minmax_poplar(first, poplar_size, compare)) {
+                    return false;
+                }
+                first += 2 * poplar_size;
+                nb_nodes -= poplar_size;
+            }
+            return true;
+        }
+    }
+}
+
+#endif // POPLAR_MINMAX_H_
@@ -0,0 +1,257 @@
+/*
+ * The MIT No Attribution License (MIT-0)
+ *
+ * Copyright (c) 2017-2020 Morwenn
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef POPLAR_MULTIQUEUE_H_
+#define POPLAR_MULTIQUEUE_H_
+
+////////////////////////////////////////////////////////////
+// Headers
+////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "poplar.h"
+
+namespace poplar
+{
+    namespace detail
+    {
+        ////////////////////////////////////////////////////////////
+        // Multiqueue helper functions
+        ////////////////////////////////////////////////////////////
+
+        // Cheap per-thread random numbers to pick the shards
+        inline auto multiqueue_random()
+            -> std::uint64_t
+        {
+            thread_local std::uint64_t state =
+                std::hash<std::thread::id>{}(std::this_thread::get_id()) | 1u;
+            // xorshift64
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            return state;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Relaxed concurrent priority queue
+    ////////////////////////////////////////////////////////////
+
+    // Relaxed concurrent priority queue made of several independently
+    // locked poplar heaps (shards): push adds an element to a random
+    // shard, and pop compares the tops of two random shards and takes
+    // the better one. Locks are only ever taken with try_lock, and a
+    // thread that fails to get one simply picks other shards, so that
+    // threads never block on each other. Popped elements are not
+    // always the highest of the whole queue, but they are close to it
+
+    template<
+        typename T,
+        typename Compare = std::less<T>
+    >
+    class concurrent_multiqueue
+    {
+        public:
+
+            ////////////////////////////////////////////////////////////
+            // Member types
+
+            using value_compare = Compare;
+            using value_type = T;
+            using size_type = std::size_t;
+
+            ////////////////////////////////////////////////////////////
+            // Construction
+
+            // Two shards per hardware thread by default, more shards
+            // means less contention but a more relaxed order
+            explicit concurrent_multiqueue(size_type count=default_shards(),
+                                           const Compare& compare=Compare()):
+                nb_shards(count == 0 ? 1 : count),
+                comp(compare)
+            {
+                // std::deque doesn't need to move the shards to grow
+                for (size_type i = 0 ; i < nb_shards ; ++i) {
+                    shards.emplace_back(comp);
+                }
+            }
+
+            concurrent_multiqueue(const concurrent_multiqueue&) = delete;
+            concurrent_multiqueue& operator=(const concurrent_multiqueue&) = delete;
+
+            ////////////////////////////////////////////////////////////
+            // Capacity
+
+            // Those are only snapshots when other threads modify the
+            // queue concurrently
+            auto empty() const
+                -> bool
+            {
+                return size() == 0;
+            }
+
+            auto size() const
+                -> size_type
+            {
+                return elements.load(std::memory_order_relaxed);
+            }
+
+            ////////////////////////////////////////////////////////////
+            // Modifiers
+
+            auto push(const value_type& value)
+                -> void
+            {
+                auto& locked = lock_random_shard();
+                std::lock_guard<std::mutex> guard(locked.mutex, std::adopt_lock);
+                locked.queue.push(value);
+                elements.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            auto push(value_type&& value)
+                -> void
+            {
+                auto& locked = lock_random_shard();
+                std::lock_guard<std::mutex> guard(locked.mutex, std::adopt_lock);
+                locked.queue.push(std::move(value));
+                elements.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            // Moves the better top of two random shards into value and
+            // returns true, or returns false when the queue is empty
+            auto try_pop(value_type& value)
+                -> bool
+            {
+                for (size_type attempt = 0 ; attempt < nb_shards ; ++attempt) {
+                    if (size() == 0) return false;
+
+                    auto first_index = random_shard();
+                    auto first = &shards[first_index];
+                    if (!first->mutex.try_lock()) continue;
+                    std::lock_guard<std::mutex> first_guard(first->mutex, std::adopt_lock);
+
+                    shard* best = first->queue.empty() ? nullptr : first;
+                    if (nb_shards > 1) {
+                        auto second_index = random_shard();
+                        if (second_index == first_index) {
+                            second_index = (second_index + 1) % nb_shards;
+                        }
+                        auto second = &shards[second_index];
+                        if (second->mutex.try_lock()) {
+                            std::lock_guard<std::mutex> second_guard(second->mutex, std::adopt_lock);
+                            if (!second->queue.empty() &&
+                                (best == nullptr || comp(best->queue.top(), second->queue.top()))) {
+                                pop_from(*second, value);
+                                return true;
+                            }
+                        }
+                    }
+                    if (best != nullptr) {
+                        pop_from(*best, value);
+                        return true;
+                    }
+                }
+
+                // The sampled shards were all empty or busy, look at all
+                // of them so that an element is always found if there
+                // is one, even when there are very few of them; the
+                // busy ones are tried again until they are seen empty
+                while (size() != 0) {
+                    bool busy = false;
+                    for (size_type i = 0 ; i < nb_shards ; ++i) {
+                        if (!shards[i].mutex.try_lock()) {
+                            busy = true;
+                            continue;
+                        }
+                        std::lock_guard<std::mutex> guard(shards[i].mutex, std::adopt_lock);
+                        if (!shards[i].queue.empty()) {
+                            pop_from(shards[i], value);
+                            return true;
+                        }
+                    }
+                    if (!busy) return false;
+                    std::this_thread::yield();
+                }
+                return false;
+            }
+
+        private:
+
+            using shard_queue = poplar::priority_queue<T, std::vector<T>, Compare>;
+
+            // Each shard gets its own cache line to avoid false sharing
+            // between the threads working on neighbouring shards
+            struct alignas(64) shard
+            {
+                explicit shard(const Compare& compare):
+                    queue(compare)
+                {}
+
+                std::mutex mutex;
+                shard_queue queue;
+            };
+
+            static auto default_shards()
+                -> size_type
+            {
+                return 2 * (std::max)(std::thread::hardware_concurrency(), 1u);
+            }
+
+            auto random_shard()
+                -> size_type
+            {
+                return detail::multiqueue_random() % nb_shards;
+            }
+
+            auto lock_random_shard()
+                -> shard&
+            {
+                while (true) {
+                    auto& res = shards[random_shard()];
+                    if (res.mutex.try_lock()) {
+                        return res;
+                    }
+                }
+            }
+
+            // The shard has to be locked and not empty
+            auto pop_from(shard& from, value_type& value)
+                -> void
+            {
+                value = from.queue.pop_value();
+                elements.fetch_sub(1, std::memory_order_relaxed);
+            }
+
+            std::deque<shard> shards;
+            size_type nb_shards;
+            Compare comp;
+            std::atomic<size_type> elements{0};
+    };
+}
+
+#endif // POPLAR_MULTIQUEUE_H_
@@ -0,0 +1,197 @@
+/*
+ * The MIT No Attribution License (MIT-0)
+ *
+ * Copyright (c) 2017-2020 Morwenn
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef POPLAR_PARALLEL_H_
+#define POPLAR_PARALLEL_H_
+
+////////////////////////////////////////////////////////////
+// Headers
+////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <execution>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include "poplar.h"
+
+namespace poplar
+{
+    namespace detail
+    {
+        ////////////////////////////////////////////////////////////
+        // Parallel helper functions
+        ////////////////////////////////////////////////////////////
+
+        // Under this number of elements, it's not worth giving work
+        // to another thread
+        constexpr std::size_t parallel_grain_size = 1 << 14;
+
+        // Number of times the work can be forked: twice as many tasks
+        // as hardware threads leaves some leeway to balance the work
+        // since the poplars are not all of the same size
+        inline auto parallel_depth()
+            -> unsigned
+        {
+            unsigned depth = 1;
+            for (auto n = std::thread::hardware_concurrency() ; n > 1 ; n >>= 1) {
+                ++depth;
+            }
+            return depth;
+        }
+
+        template<typename ExecutionPolicy>
+        using is_parallel_policy = std::integral_constant<
+            bool,
+            std::is_same<ExecutionPolicy, std::execution::parallel_policy>::value ||
+            std::is_same<ExecutionPolicy, std::execution::parallel_unsequenced_policy>::value
+        >;
+
+        // Builds a poplar of the given size: the two subpoplars are
+        // independent and can be built in parallel before sifting
+        // the root, which is the top-down make_heap method described
+        // in the README
+        template<typename RandomAccessIterator, typename Size,
+                 typename Compare, typename SiftPolicy>
+        auto parallel_make_poplar(RandomAccessIterator first, Size size, Compare compare,
+                                  SiftPolicy policy, unsigned depth)
+            -> void
+        {
+            if (depth == 0 || size <= parallel_grain_size) {
+                make_poplar(first, size, std::move(compare), policy);
+                return;
+            }
+
+            auto left = std::async(std::launch::async, [=] {
+                parallel_make_poplar(first, size / 2, compare, policy, depth - 1);
+            });
+            parallel_make_poplar(first + size / 2, size / 2, compare, policy, depth - 1);
+            left.get();
+
+            sift(first, size, std::move(compare), policy);
+        }
+
+        // The poplars of a poplar heap are independent of each other
+        // during construction, so the first one can be built while the
+        // ones following it are built by another thread
+        template<typename RandomAccessIterator, typename Size,
+                 typename Compare, typename SiftPolicy>
+        auto parallel_make_heap(RandomAccessIterator first, Size size, Compare compare,
+                                SiftPolicy policy, unsigned depth)
+            -> void
+        {
+            Size poplar_size = bit_floor(size + 1u) - 1u;
+            if (size == poplar_size) {
+                parallel_make_poplar(first, size, std::move(compare), policy, depth);
+                return;
+            }
+            if (depth == 0 || size <= parallel_grain_size) {
+                poplar::make_heap(first, first + size, std::move(compare), policy);
+                return;
+            }
+
+            auto rest = std::async(std::launch::async, [=] {
+                parallel_make_heap(first + poplar_size, size - poplar_size,
+                                   compare, policy, depth - 1);
+            });
+            parallel_make_poplar(first, poplar_size, compare, policy, depth - 1);
+            rest.get();
+        }
+
+        // Sorts both halves of the sequence in parallel with poplar sort,
+        // then merges them
+        template<typename RandomAccessIterator, typename Compare, typename SiftPolicy>
+        auto parallel_sort(RandomAccessIterator first, RandomAccessIterator last,
+                           Compare compare, SiftPolicy policy, unsigned depth)
+            -> void
+        {
+            auto size = std::distance(first, last);
+            if (depth == 0 || std::size_t(size) <= parallel_grain_size) {
+                poplar::sort(std::move(first), std::move(last), std::move(compare), policy);
+                return;
+            }
+
+            auto middle = std::next(first, size / 2);
+            auto left = std::async(std::launch::async, [=] {
+                parallel_sort(first, middle, compare, policy, depth - 1);
+            });
+            parallel_sort(middle, last, compare, policy, depth - 1);
+            left.get();
+
+            std::inplace_merge(std::move(first), std::move(middle), std::move(last),
+                               std::move(compare));
+        }
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Parallel make_heap
+    ////////////////////////////////////////////////////////////
+
+    template<
+        typename ExecutionPolicy,
+        typename RandomAccessIterator,
+        typename Compare = std::less<>,
+        typename SiftPolicy = default_sift_t
+    >
+    auto make_heap(ExecutionPolicy&&, RandomAccessIterator first, RandomAccessIterator last,
+                   Compare compare={}, SiftPolicy policy={})
+        -> std::enable_if_t<std::is_execution_policy<std::decay_t<ExecutionPolicy>>::value>
+    {
+        if (!detail::is_parallel_policy<std::decay_t<ExecutionPolicy>>::value) {
+            poplar::make_heap(std::move(first), std::move(last), std::move(compare), policy);
+            return;
+        }
+
+        using poplar_size_t = std::make_unsigned_t<
+            typename std::iterator_traits<RandomAccessIterator>::difference_type
+        >;
+        poplar_size_t size = std::distance(first, last);
+        if (size < 2) return;
+
+        detail::parallel_make_heap(std::move(first), size, std::move(compare),
+                                   policy, detail::parallel_depth());
+    }
+
+    ////////////////////////////////////////////////////////////
+    // Parallel sort
+    ////////////////////////////////////////////////////////////
+
+    template<
+        typename ExecutionPolicy,
+        typename RandomAccessIterator,
+        typename Compare = std::less<>,
+        typename SiftPolicy = default_sift_t
+    >
+    auto sort(ExecutionPolicy&&, RandomAccessIterator first, RandomAccessIterator last,
+              Compare compare={}, SiftPolicy policy={})
+        -> std::enable_if_t<std::is_execution_policy<std::decay_t<ExecutionPolicy>>::value>
+    {
+        if (!detail::is_parallel_policy<std::decay_t<ExecutionPolicy>>::value) {
+            poplar::sort(std::move(first), std::move(last), std::move(compare), policy);
+            return;
+        }
+        detail::parallel_sort(std::move(first), std::move(last), std::move(compare),
+                              policy, detail::parallel_depth());
+    }
+}
+
+#endif // POPLAR_PARALLEL_H_
@@ -0,0 +1,414 @@
+/*
+ * The MIT No Attribution License (MIT-0)
+ *
+ * Copyright (c) 2017-2020 Morwenn
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef POPLAR_RANGES_H_
+#define POPLAR_RANGES_H_
+
+////////////////////////////////////////////////////////////
+// Headers
+////////////////////////////////////////////////////////////
+#include <functional>
+#include <iterator>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+#include "poplar.h"
+
+namespace poplar
+{
+    namespace detail
+    {
+        ////////////////////////////////////////////////////////////
+        // Projections
+
+        template<typename Compare, typename Projection>
+        struct projected_compare
+        {
+            [[no_unique_address]] Compare compare;
+            [[no_unique_address]] Projection projection;
+
+            template<typename T, typename U>
+            constexpr auto operator()(T&& lhs, U&& rhs)
+                -> bool
+            {
+                return std::invoke(compare,
+                                   std::invoke(projection, std::forward<T>(lhs)),
+                                   std::invoke(projection, std::forward<U>(rhs)));
+            }
+        };
+
+        // Replaces the std::ranges comparators by the standard function
+        // objects the algorithms have optimizations for
+        template<typename Compare>
+        constexpr auto make_standard_compare(Compare compare)
+        {
+            if constexpr (std::is_same_v<Compare, std::ranges::less>) {
+                return std::less<>{};
+            } else if constexpr (std::is_same_v<Compare, std::ranges::greater>) {
+                return std::greater<>{};
+            } else {
+                return compare;
+            }
+        }
+
+        // Turns a comparator and a projection into a single comparator
+        // for the poplar algorithms; an identity projection is dropped
+        template<typename Compare, typename Projection>
+        constexpr auto make_projected_compare(Compare compare, Projection projection)
+        {
+            auto standard_compare = make_standard_compare(std::move(compare));
+            if constexpr (!std::is_same_v<Projection, std::identity>) {
+                return projected_compare<decltype(standard_compare), Projection>{
+                    std::move(standard_compare), std::move(projection)
+                };
+            } else {
+                return standard_compare;
+            }
+        }
+
+        // Projections onto arithmetic keys compared with std::less or
+        // std::greater get the branchless paths of the algorithms, which
+        // then only copy and compare the projected keys
+        template<typename Compare, typename Projection, typename T>
+        struct branchless_compare_traits<
+            projected_compare<Compare, Projection>, T,
+            std::enable_if_t<branchless_compare_traits<
+                Compare,
+                std::remove_cvref_t<std::invoke_result_t<Projection&, const T&>>
+            >::value>
+        >:
+            std::true_type
+        {
+            using key_type = std::remove_cvref_t<std::invoke_result_t<Projection&, const T&>>;
+
+            static constexpr auto key(projected_compare<Compare, Projection>& compare, const T& value)
+                -> key_type
+            {
+                return std::invoke(compare.projection, value);
+            }
+
+            static constexpr auto compare_keys(projected_compare<Compare, Projection>& compare,
+                                               key_type lhs, key_type rhs)
+                -> bool
+            {
+                return branchless_compare_traits<Compare, key_type>::compare_keys(compare.compare,
+                                                                                  lhs, rhs);
+            }
+        };
+    }
+
+    namespace ranges
+    {
+        ////////////////////////////////////////////////////////////
+        // push_heap
+
+        template<
+            std::random_access_iterator Iterator,
+            std::sentinel_for<Iterator> Sentinel,
+            typename Compare = std::ranges::less,
+            typename Projection = std::identity,
+            typename SiftPolicy = default_sift_t
+        >
+            requires std::sortable<Iterator, Compare, Projection>
+        auto push_heap(Iterator first, Sentinel last, Compare compare={},
+                       Projection projection={}, SiftPolicy policy={})
+            -> Iterator
+        {
+            auto last_it = std::ranges::next(first, last);
+            poplar::push_heap(std::move(first), last_it,
+                              detail::make_projected_compare(std::move(compare), std::move(projection)),
+                              policy);
+            return last_it;
+        }
+
+        template<
+            std::ranges::random_access_range Range,
+            typename Compare = std::ranges::less,
+            typename Projection = std::identity,
+            typename SiftPolicy = default_sift_t
+        >
+            requires std::sortable<std::ranges::iterator_t<Range>, Compare, Projection>
+        auto push_heap(Range&& range, Compare compare={},
+                       Projection projection={}, SiftPolicy policy={})
+            -> std::ranges::borrowed_iterator_t<Range>
+        {
+            return ranges::push_heap(std::ranges::begin(range), std::ranges::end(range),
+                                     std::move(compare), std::move(projection), policy);
+        }
+
+        ////////////////////////////////////////////////////////////
+        // pop_heap
+
+        template<
+            std::random_access_iterator Iterator,
+            std::sentinel_for<Iterator> Sentinel,
+            typename Compare = std::ranges::less,
+            typename Projection = std::identity,
+            typename SiftPolicy = default_sift_t
+        >
+            requires std::sortable<Iterator, Compare, Projection>
+        auto pop_heap(Iterator first, Sentinel last, Compare compare={},
+                      Projection projection={}, SiftPolicy policy={})
+            -> Iterator
+        {
+            auto last_it = std::ranges::next(first, last);
+            poplar::pop_heap(std::move(first), last_it,
+                             detail::make_projected_compare(std::move(compare), std::move(projection)),
+                             policy);
+            return last_it;
+        }
+
+        template<
+            std::ranges::random_access_range Range,
+            typename Compare = std::ranges::less,
+            typename Projection = std::identity,
+            typename SiftPolicy = default_sift_t
+        >
+            requires std::sortable<std::ranges::iterator_t<Range>, Compare, Projection>
+        auto pop_heap(Range&& range, Compare compare={},
+                      Projection projection={}, SiftPolicy policy={})
+            -> std::ranges::borrowed_iterator_t<Range>
+        {
+            return ranges::pop_heap(std::ranges::begin(range), std::ranges::end(range),
+                                    std::move(compare), std::move(projection), policy);
+        }
+
+        ////////////////////////////////////////////////////////////
+        // make_heap
+
+        template<
+            std::random_access_iterator Iterator,
+            std::sentinel_for<Iterator> Sentinel,
+            typename Compare = std::ranges::less,
+            typename Projection = std::identity,
+            typename SiftPolicy = default_sift_t
+        >
+            requires std::sortable<Iterator, Compare, Projection>
+        auto make_heap(Iterator first, Sentinel last, Compare compare={},
+                       Projection projection={}, SiftPolicy policy={})
+            -> Iterator
+        {
+            auto last_it = std::ranges::next(first, last);
+            poplar::make_heap(std::move(first), last_it,
+                              detail::make_projected_compare(std::move(compare), std::move(projection)),
+                              policy);
+            return last_it;
+        }
+
+        template<
+            std::ranges::random_access_range Range,
+            typename Compare = std::ranges::less,
+            typename Projection = std::identity,
+            typename SiftPolicy = default_sift_t
+        >
+            requires std::sortable<std::ranges::iterator_t<Range>, Compare, Projection>
+        auto make_heap(Range&& range, Compare compare={},
+                       Projection projection={}, SiftPolicy policy={})
+            -> std::ranges::borrowed_iterator_t<Range>
+        {
+            return ranges::make_heap(std::ranges::begin(range), std::ranges::end(range),
+                                     std::move(compare), std::move(projection), policy);
+        }
+
+        ////////////////////////////////////////////////////////////
+        // sort_heap
+
+        template<
+            std::random_access_iterator Iterator,
+            std::sentinel_for<Iterator> Sentinel,
+            typename Compare = std::ranges::less,
+            typename Projection = std::identity,
+            typename SiftPolicy = default_sift_t
+        >
+            requires std::sortable<Iterator, Compare, Projection>
+        auto sort_heap(Iterator first, Sentinel last, Compare compare={},
+                       Projection projection={}, SiftPolicy policy={})
+            -> Iterator
+        {
+            auto last_it = std::ranges::next(first, last);
+            poplar::sort_heap(std::move(first), last_it,
+                              detail::make_projected_compare(std::move(compare), std::move(projection)),
+                              policy);
+            return last_it;
+        }
+
+        template<
+            std::ranges::random_access_range Range,
+            typename Compare = std::ranges::less,
+            typename Projection = std::identity,
+            typename SiftPolicy = default_sift_t
+        >
+            requires std::sortable<std::ranges::iterator_t<Range>, Compare, Projection>
+        auto sort_heap(Range&& range, Compare compare={},
+                       Projection projection={}, SiftPolicy policy={})
+            -> std::ranges::borrowed_iterator_t<Range>
+        {
+            return ranges::sort_heap(std::ranges::begin(range), std::ranges::end(range),
+                                     std::move(compare), std::move(projection), policy);
+        }
+
+        ////////////////////////////////////////////////////////////
+        // sort
+
+        template<
+            std::random_access_iterator Iterator,
+            std::sentinel_for<Iterator> Sentinel,
+            typename Compare = std::ranges::less,
+            typename Projection = std::identity,
+            typename SiftPolicy = default_sift_t
+        >
+            requires std::sortable<Iterator, Compare, Projection>
+        auto sort(Iterator first, Sentinel last, Compare compare={},
+                  Projection projection={}, SiftPolicy policy={})
+            -> Iterator
+        {
+            auto last_it = std::ranges::next(first, last);
+            poplar::sort(std::move(first), last_it,
+                         detail::make_projected_compare(std::move(compare), std::move(projection)),
+                         policy);
+            return last_it;
+        }
+
+        template<
+            std::ranges::random_access_range Range,
+            typename Compare = std::ranges::less,
+            typename Projection = std::identity,
+            typename SiftPolicy = default_sift_t
+        >
+            requires std::sortable<std::ranges::iterator_t<Range>, Compare, Projection>
+        auto sort(Range&& range, Compare compare={},
+                  Projection projection={}, SiftPolicy policy={})
+            -> std::ranges::borrowed_iterator_t<Range>
+        {
+            return ranges::sort(std::ranges::begin(range), std::ranges::end(range),
+                                std::move(compare), std::move(projection), policy);
+        }
+
+        ////////////////////////////////////////////////////////////
+        // sort_by_key
+
+        // Same as poplar::sort_by_key, the projection being the key
+        // function: it is called once per element, which is worth it
+        // when the projection is expensive
+        template<
+            std::random_access_iterator Iterator,
+            std::sentinel_for<Iterator> Sentinel,
+            typename Compare = std::ranges::less,
+            typename Projection = std::identity,
+            typename SiftPolicy = default_sift_t
+        >
+            requires std::sortable<Iterator, Compare, Projection>
+        auto sort_by_key(Iterator first, Sentinel last, Compare compare={},
+                         Projection projection={}, SiftPolicy policy={})
+            -> Iterator
+        {
+            auto last_it = std::ranges::next(first, last);
+            poplar::sort_by_key(std::move(first), last_it,
+                                [&projection](const auto& value) {
+                                    return std::invoke(projection, value);
+                                },
+                                detail::make_standard_compare(std::move(compare)),
+                                policy);
+            return last_it;
+        }
+
+        template<
+            std::ranges::random_access_range Range,
+            typename Compare = std::ranges::less,
+            typename Projection = std::identity,
+            typename SiftPolicy = default_sift_t
+        >
+            requires std::sortable<std::ranges::iterator_t<Range>, Compare, Projection>
+        auto sort_by_key(Range&& range, Compare compare={},
+                         Projection projection={}, SiftPolicy policy={})
+            -> std::ranges::borrowed_iterator_t<Range>
+        {
+            return ranges::sort_by_key(std::ranges::begin(range), std::ranges::end(range),
+                                       std::move(compare), std::move(projection), policy);
+        }
+
+        ////////////////////////////////////////////////////////////
+        // is_heap_until
+
+        template<
+            std::random_access_iterator Iterator,
+            std::sentinel_for<Iterator> Sentinel,
+            typename Projection = std::identity,
+            std::indirect_strict_weak_order<std::projected<Iterator, Projection>> Compare = std::ranges::less
+        >
+        auto is_heap_until(Iterator first, Sentinel last, Compare compare={},
+                           Projection projection={})
+            -> Iterator
+        {
+            auto last_it = std::ranges::next(first, last);
+            return poplar::is_heap_until(std::move(first), std::move(last_it),
+                                         detail::make_projected_compare(std::move(compare),
+                                                                        std::move(projection)));
+        }
+
+        template<
+            std::ranges::random_access_range Range,
+            typename Projection = std::identity,
+            std::indirect_strict_weak_order<
+                std::projected<std::ranges::iterator_t<Range>, Projection>
+            > Compare = std::ranges::less
+        >
+        auto is_heap_until(Range&& range, Compare compare={}, Projection projection={})
+            -> std::ranges::borrowed_iterator_t<Range>
+        {
+            return ranges::is_heap_until(std::ranges::begin(range), std::ranges::end(range),
+                                         std::move(compare), std::move(projection));
+        }
+
+        ////////////////////////////////////////////////////////////
+        // is_heap
+
+        template<
+            std::random_access_iterator Iterator,
+            std::sentinel_for<Iterator> Sentinel,
+            typename Projection = std::identity,
+            std::indirect_strict_weak_order<std::projected<Iterator, Projection>> Compare = std::ranges::less
+        >
+        auto is_heap(Iterator first, Sentinel last, Compare compare={},
+                     Projection projection={})
+            -> bool
+        {
+            auto last_it = std::ranges::next(first, last);
+            return ranges::is_heap_until(std::move(first), last_it,
+                                         std::move(compare), std::move(projection)) == last_it;
+        }
+
+        template<
+            std::ranges::random_access_range Range,
+            typename Projection = std::identity,
+            std::indirect_strict_weak_order<
+                std::projected<std::ranges::iterator_t<Range>, Projection>
+            > Compare = std::ranges::less
+        >
+        auto is_heap(Range&& range, Compare compare={}, Projection projection={})
+            -> bool
+        {
+            return ranges::is_heap(std::ranges::begin(range), std::ranges::end(range),
+                                   std::move(compare), std::move(projection));
+        }
+    }
+}
+
+#endif // POPLAR_RANGES_H_
@@ -0,0 +1,317 @@
+/*
+ * The MIT No Attribution License (MIT-0)
+ *
+ * Copyright (c) 2017-2020 Morwenn
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef POPLAR_WIDE_H_
+#define POPLAR_WIDE_H_
+
+////////////////////////////////////////////////////////////
+// Headers
+////////////////////////////////////////////////////////////
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include "poplar.h"
+
+namespace poplar
+{
+    namespace detail
+    {
+        ////////////////////////////////////////////////////////////
+        // Wide poplar specific helper functions
+        ////////////////////////////////////////////////////////////
+
+        // A wide poplar of arity B is a perfect B-ary tree stored in
+        // post-order: its B subpoplars come first, one after the other,
+        // followed by its root. Its size is of the form (B^k-1)/(B-1),
+        // and the size of its subpoplars is (size-1)/B
+
+        // Returns the size of the biggest wide poplar that fits in n
+        // elements, assumes n > 0
+        template<std::size_t Arity, typename Size>
+        constexpr auto wide_poplar_size(Size n)
+            -> Size
+        {
+            Size size = 1;
+            while (size <= (n - 1) / Arity) {
+                size = size * Arity + 1;
+            }
+            return size;
+        }
+
+        // Returns the biggest of the children roots of a wide poplar
+        template<std::size_t Arity, typename RandomAccessIterator, typename Size, typename Compare>
+        auto wide_max_child(RandomAccessIterator first, Size child_size, Compare& compare)
+            -> RandomAccessIterator
+        {
+            auto max_root = first + (child_size - 1);
+            auto child_root = max_root;
+            for (std::size_t i = 1 ; i < Arity ; ++i) {
+                child_root += child_size;
+                if (compare(*max_root, *child_root)) {
+                    max_root = child_root;
+                }
+            }
+            return max_root;
+        }
+
+        // Sifts the root of a wide poplar down to its place; it costs
+        // about B comparisons and one move per level, but there are only
+        // log_B(n) levels, which means fewer cache lines and pages touched
+        // per sift than in a regular poplar
+        template<std::size_t Arity, typename RandomAccessIterator, typename Size, typename Compare>
+        auto wide_sift(RandomAccessIterator first, Size size, Compare compare)
+            -> void
+        {
+            sift_recorder recorder;
+            if (size < 2) return;
+
+            auto root = first + (size - 1);
+            size = (size - 1) / Arity;
+            auto max_root = wide_max_child<Arity>(first, size, compare);
+            if (!compare(*root, *max_root)) return;
+
+            auto tmp = std::move(*root);
+            do {
+                *root = std::move(*max_root);
+                root = max_root;
+                record_moves(1);
+                recorder.level();
+
+                if (size < 2) break;
+                first = root - (size - 1);
+                size = (size - 1) / Arity;
+                max_root = wide_max_child<Arity>(first, size, compare);
+            } while (compare(tmp, *max_root));
+            *root = std::move(tmp);
+            record_moves(2);
+        }
+
+        // Builds a wide poplar in a top-down fashion: the subpoplars are
+        // built recursively then the root is sifted; small poplars are
+        // simply sorted since a sorted sequence is a valid wide poplar
+        template<std::size_t Arity, typename RandomAccessIterator, typename Size, typename Compare>
+        auto make_wide_poplar(RandomAccessIterator first, Size size, Compare compare)
+            -> void
+        {
+            using value_type = typename std::iterator_traits<RandomAccessIterator>::value_type;
+            if (size <= poplar::small_poplar_size<value_type>::value) {
+                insertion_sort(first, first + size, std::move(compare));
+                return;
+            }
+
+            Size child_size = (size - 1) / Arity;
+            for (std::size_t i = 0 ; i < Arity ; ++i) {
+                make_wide_poplar<Arity>(first + i * child_size, child_size, compare);
+            }
+            wide_sift<Arity>(std::move(first), size, std::move(compare));
+        }
+
+        template<std::size_t Arity, typename RandomAccessIterator, typename Size, typename Compare>
+        auto is_wide_poplar(RandomAccessIterator first, Size size, Compare& compare)
+            -> bool
+        {
+            if (size < 2) return true;
+
+            auto root = first + (size - 1);
+            Size child_size = (size - 1) / Arity;
+            for (std::size_t i = 0 ; i < Arity ; ++i) {
+                auto child_first = first + i * child_size;
+                if (compare(*root, child_first[child_size - 1])) return false;
+                if (!is_wide_poplar<Arity>(child_first, child_size, compare)) return false;
+            }
+            return true;
+        }
+
+        template<typename RandomAccessIterator>
+        using wide_poplar_size_t = std::make_unsigned_t<
+            typename std::iterator_traits<RandomAccessIterator>::difference_type
+        >;
+    }
+
+    namespace wide
+    {
+        ////////////////////////////////////////////////////////////
+        // Wide poplar heap algorithms
+        ////////////////////////////////////////////////////////////
+
+        // A wide poplar heap is a sequence of wide poplars whose sizes
+        // follow the same greedy decomposition as the one of a poplar
+        // heap: the biggest possible wide poplar first, then the biggest
+        // possible one in the remaining elements, and so on. With B = 2
+        // it is exactly a poplar heap
+
+        template<
+            std::size_t Arity = 4,
+            typename RandomAccessIterator,
+            typename Compare = std::less<>
+        >
+        auto push_heap(RandomAccessIterator first, RandomAccessIterator last,
+                       Compare compare={})
+            -> void
+        {
+            static_assert(Arity >= 2, "the arity of a wide poplar must be at least 2");
+            using poplar_size_t = detail::wide_poplar_size_t<RandomAccessIterator>;
+            poplar_size_t size = std::distance(first, last);
+            if (size < 2) return;
+
+            // Find the size of the last poplar, the one rooted at the
+            // pushed element
+            auto poplar_size = detail::wide_poplar_size<Arity>(size);
+            while (size != poplar_size) {
+                size -= poplar_size;
+                while (poplar_size > size) {
+                    poplar_size = (poplar_size - 1) / Arity;
+                }
+            }
+            detail::wide_sift<Arity>(last - poplar_size, poplar_size, std::move(compare));
+        }
+
+        template<
+            std::size_t Arity = 4,
+            typename RandomAccessIterator,
+            typename Compare = std::less<>
+        >
+        auto pop_heap(RandomAccessIterator first, RandomAccessIterator last,
+                      Compare compare={})
+            -> void
+        {
+            static_assert(Arity >= 2, "the arity of a wide poplar must be at least 2");
+            using poplar_size_t = detail::wide_poplar_size_t<RandomAccessIterator>;
+            poplar_size_t size = std::distance(first, last);
+            if (size < 2) return;
+
+            // Find the bigger poplar root
+            auto last_root = std::prev(last);
+            auto bigger = last_root;
+            poplar_size_t bigger_size = 0;
+            auto poplar_size = detail::wide_poplar_size<Arity>(size);
+            while (true) {
+                auto root = first + (poplar_size - 1);
+                if (root == last_root) break;
+                if (compare(*bigger, *root)) {
+                    bigger = root;
+                    bigger_size = poplar_size;
+                }
+                first = std::next(root);
+                size -= poplar_size;
+                while (poplar_size > size) {
+                    poplar_size = (poplar_size - 1) / Arity;
+                }
+            }
+
+            // Swap it with the last root and sift it into its poplar;
+            // the subpoplars of the last root become poplars of the heap
+            if (bigger != last_root) {
+                using std::iter_swap;
+                iter_swap(bigger, last_root);
+                detail::record_swaps(1);
+                detail::wide_sift<Arity>(bigger - (bigger_size - 1), bigger_size,
+                                         std::move(compare));
+            }
+        }
+
+        template<
+            std::size_t Arity = 4,
+            typename RandomAccessIterator,
+            typename Compare = std::less<>
+        >
+        auto make_heap(RandomAccessIterator first, RandomAccessIterator last,
+                       Compare compare={})
+            -> void
+        {
+            static_assert(Arity >= 2, "the arity of a wide poplar must be at least 2");
+            using poplar_size_t = detail::wide_poplar_size_t<RandomAccessIterator>;
+            poplar_size_t size = std::distance(first, last);
+            if (size < 2) return;
+
+            auto poplar_size = detail::wide_poplar_size<Arity>(size);
+            while (size != 0) {
+                while (poplar_size > size) {
+                    poplar_size = (poplar_size - 1) / Arity;
+                }
+                detail::make_wide_poplar<Arity>(first, poplar_size, compare);
+                first += poplar_size;
+                size -= poplar_size;
+            }
+        }
+
+        template<
+            std::size_t Arity = 4,
+            typename RandomAccessIterator,
+            typename Compare = std::less<>
+        >
+        auto sort_heap(RandomAccessIterator first, RandomAccessIterator last,
+                       Compare compare={})
+            -> void
+        {
+            static_assert(Arity >= 2, "the arity of a wide poplar must be at least 2");
+            if (std::distance(first, last) < 2) return;
+
+            for (auto it = last ; it != std::next(first) ; --it) {
+                wide::pop_heap<Arity>(first, it, compare);
+            }
+        }
+
+        template<
+            std::size_t Arity = 4,
+            typename RandomAccessIterator,
+            typename Compare = std::less<>
+        >
+        auto sort(RandomAccessIterator first, RandomAccessIterator last,
+                  Compare compare={})
+            -> void
+        {
+            wide::make_heap<Arity>(first, last, compare);
+            wide::sort_heap<Arity>(std::move(first), std::move(last), std::move(compare));
+        }
+
+        template<
+            std::size_t Arity = 4,
+            typename RandomAccessIterator,
+            typename Compare = std::less<>
+        >
+        auto is_heap(RandomAccessIterator first, RandomAccessIterator last,
+                     Compare compare={})
+            -> bool
+        {
+            static_assert(Arity >= 2, "the arity of a wide poplar must be at least 2");
+            using poplar_size_t = detail::wide_poplar_size_t<RandomAccessIterator>;
+            poplar_size_t size = std::distance(first, last);
+            if (size < 2) return true;
+
+            auto poplar_size = detail::wide_poplar_size<Arity>(size);
+            while (size != 0) {
+                while (poplar_size > size) {
+                    poplar_size = (poplar_size - 1) / Arity;
+                }
+                if (!detail::is_wide_poplar<Arity>(first, poplar_size, compare)) {
+                    return false;
+                }
+                first += poplar_size;
+                size -= poplar_size;
+            }
+            return true;
+        }
+    }
+}
+
+#endif // POPLAR_WIDE_H_